@@ -4,6 +4,50 @@
 using namespace mpcs51044_ps;
 using namespace std;
 
+// Constant matrices, their products and determinants are computed by the
+// compiler: none of this would compile otherwise
+constexpr Matrix<double, 2, 3> a = {
+		{ 1, 2, 3, },
+		{ 4, 5, 6, }
+};
+constexpr Matrix<double, 3, 2> b = {
+		{  7,  8, },
+		{  9, 10, },
+		{ 11, 12, }
+};
+constexpr auto ab = a * b;
+static_assert(ab(0, 0) == 58 && ab(0, 1) == 64 && ab(1, 0) == 139 && ab(1, 1) == 154);
+static_assert(ab.determinant() == 36);
+static_assert((ab + ab)(1, 0) == 278 && (2.0 * ab)(0, 1) == 128);
+static_assert((a.transpose() * b.transpose())(0, 0) == 39);
+static_assert(Matrix<double, 3, 2>(a.transpose())(2, 1) == 6);
+constexpr Matrix<int, 4, 4> four = {
+		{ 2, 0, 0, 1, },
+		{ 0, 3, 0, 0, },
+		{ 0, 0, 4, 0, },
+		{ 1, 0, 0, 5, }
+};
+static_assert(four.determinant() == 108);
+static_assert(four.minor(3, 3).determinant() == 24);
+// Vandermonde matrix of 1..8: the determinant 1!2!...7! overflows an int,
+// the entries don't
+constexpr auto vandermonde = [] {
+	Matrix<long long, 8, 8> v;
+	for (int i = 0; i < 8; i++) {
+		long long x = 1;
+		for (int j = 0; j < 8; j++, x *= i + 1)
+			v(i, j) = x;
+	}
+	return v;
+}();
+static_assert(vandermonde.determinant() == 125'411'328'000LL);
+constexpr Matrix<double, 4, 4> fourTransposed(Matrix<double, 4, 4>{
+		{ 2, 0, 0, 1, },
+		{ 0, 3, 0, 0, },
+		{ 0, 0, 4, 0, },
+		{ 1, 0, 0, 5, } }.transpose());
+static_assert(fourTransposed.determinant() == 108);
+
 int main()
 {
 	auto start = chrono::system_clock::now();
@@ -8,6 +8,14 @@
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <type_traits>
+#include <concepts>
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_lu.h"
+#include "ex_4_matrix_cholesky.h"
+#include "ex_4_matrix_bareiss.h"
+#include "ex_4_matrix_format.h"
+#include "ex_4_matrix_storage.h"
 #undef minor
 using std::initializer_list;
 using std::array;
@@ -21,115 +29,403 @@ using std::streamsize;
 using std::setw;
 
 namespace mpcs51044_ps {
+using mpcs51044::InlineStorage;
+using mpcs51044::HeapStorage;
+using mpcs51044::PaddedStorage;
+using mpcs51044::DefaultStorage;
 
-template<typename T, int rows, int cols = rows>
-class MatrixCommon {
-public:
-	MatrixCommon(initializer_list<initializer_list<T>> init) {
-		auto dp = data.begin();
-		for (auto row : init) {
-			std::copy(row.begin(), row.end(), dp->begin());
-			dp++;
+template<typename T, int rows, int cols = rows, template<typename, int, int> class Storage = DefaultStorage>
+class Matrix;
+
+// Shared by Matrix, MatrixView and (passing their runtime sizes) SparseMatrix
+template<typename M>
+ostream &printMatrix(ostream &os, M const &m, int rows = M::nrows, int cols = M::ncols)
+{
+	return mpcs51044::formatMatrix(os, m, rows, cols);
+}
+
+// Closed forms up to 3x3, cofactor expansion down the first column beyond.
+// minor() returns a view, so the expansion copies nothing.
+template<typename M>
+constexpr typename M::value_type cofactorDeterminant(M const &d)
+{
+	using T = typename M::value_type;
+	constexpr int n = M::nrows;
+	static_assert(n == M::ncols, "Sorry, only square matrices have determinants");
+	if constexpr (n == 1) {
+		return d(0, 0);
+	} else if constexpr (n == 2) {
+		return d(0, 0) * d(1, 1) - d(1, 0) * d(0, 1);
+	} else if constexpr (n == 3) {
+		return d(0, 0) * (d(1, 1) * d(2, 2) - d(1, 2) * d(2, 1))
+			- d(0, 1) * (d(1, 0) * d(2, 2) - d(1, 2) * d(2, 0))
+			+ d(0, 2) * (d(1, 0) * d(2, 1) - d(1, 1) * d(2, 0));
+	} else {
+		T val = 0;
+		for (int i = 0; i < n; i++) {
+			val += (i % 2 ? -1 : 1)
+				* d(i, 0)
+				* cofactorDeterminant(d.minor(i, 0));
 		}
+		return val;
 	}
-	MatrixCommon() : data{} {}
-	T &operator()(int x, int y) {
-		return data[x][y];
+}
+
+//////////////////////////////////////////
+// MATRIXVIEW: zero-copy minors, transposes and blocks
+//////////////////////////////////////////
+// A read-only window onto another matrix's elements. Element (x, y) lives at
+// base[rowOffsets[x] + colOffsets[y]], so
+//   transpose()        swaps the two offset tables
+//   block<r, c>(i, j)  takes a slice of each table
+//   minor(r, c)        drops one entry from each table
+// and all three cost O(rows + cols) instead of copying O(rows * cols)
+// elements. Views compose (a minor of a transpose of a block is still a
+// view) and, like any reference, must not outlive the matrix they look at.
+//
+// The GEMM kernel reads its operands through operator(), so a view can be
+// multiplied directly; while it is still a plain strided window (no row or
+// column dropped) it also exposes the strides.
+template<typename T, int rows, int cols>
+class MatrixView {
+public:
+	using value_type = T;
+	static constexpr int nrows = rows;
+	static constexpr int ncols = cols;
+
+	constexpr MatrixView(T const *base, ptrdiff_t rowStride, ptrdiff_t colStride)
+		: base(base), rs(rowStride), cs(colStride), linear(true) {
+		for (int i = 0; i < rows; i++)
+			rowOffsets[i] = i * rs;
+		for (int j = 0; j < cols; j++)
+			colOffsets[j] = j * cs;
+	}
+
+	constexpr T operator()(int x, int y) const {
+		return base[rowOffsets[x] + colOffsets[y]];
+	}
+
+	constexpr MatrixView<T, cols, rows> transpose() const {
+		MatrixView<T, cols, rows> result;
+		result.base = base;
+		result.rs = cs;
+		result.cs = rs;
+		result.linear = linear;
+		result.rowOffsets = colOffsets;
+		result.colOffsets = rowOffsets;
+		return result;
+	}
+
+	template<int r, int c>
+	constexpr MatrixView<T, r, c> block(int i, int j) const {
+		static_assert(r <= rows && c <= cols, "Block must fit inside the matrix");
+		MatrixView<T, r, c> result;
+		result.base = base;
+		result.rs = rs;
+		result.cs = cs;
+		result.linear = linear;
+		std::copy(rowOffsets.begin() + i, rowOffsets.begin() + i + r, result.rowOffsets.begin());
+		std::copy(colOffsets.begin() + j, colOffsets.begin() + j + c, result.colOffsets.begin());
+		return result;
 	}
 
-	T operator()(int x, int y) const {
-		return data[x][y];
+	constexpr MatrixView<T, rows - 1, cols - 1> minor(int r, int c) const {
+		MatrixView<T, rows - 1, cols - 1> result;
+		result.base = base;
+		result.rs = rs;
+		result.cs = cs;
+		// Dropping the last row and column keeps the offsets evenly spaced
+		result.linear = linear && r == rows - 1 && c == cols - 1;
+		std::copy(rowOffsets.begin(), rowOffsets.begin() + r, result.rowOffsets.begin());
+		std::copy(rowOffsets.begin() + r + 1, rowOffsets.end(), result.rowOffsets.begin() + r);
+		std::copy(colOffsets.begin(), colOffsets.begin() + c, result.colOffsets.begin());
+		std::copy(colOffsets.begin() + c + 1, colOffsets.end(), result.colOffsets.begin() + c);
+		return result;
+	}
+
+	// True while the view is base + x * rowStride() + y * colStride()
+	constexpr bool strided() const {
+		return linear;
+	}
+	constexpr T const *origin() const {
+		return base + rowOffsets[0] + colOffsets[0];
+	}
+	constexpr ptrdiff_t rowStride() const {
+		return rs;
+	}
+	constexpr ptrdiff_t colStride() const {
+		return cs;
+	}
+
+	constexpr T determinant() const {
+		if constexpr (std::is_floating_point_v<T> && rows > 3) {
+			if (std::is_constant_evaluated())
+				return mpcs51044::eliminationDeterminant<T>(rows, *this);
+			// LU works in place, so it needs its own copy anyway
+			return Matrix<T, rows, cols>(*this).determinant();
+		} else if constexpr (std::is_integral_v<T> && rows > 3) {
+			return mpcs51044::bareissDeterminant<T>(rows, *this);
+		} else {
+			return cofactorDeterminant(*this);
+		}
 	}
 
 	inline friend
 		ostream &
 		operator<<
-		(ostream &os, const MatrixCommon<T, rows, cols> &m) {
-		size_t width = m.longestElementSize() + 2;
-		os << "[ " << endl;
-		for (int i = 0; i < rows; i++) {
-			for (int j = 0; j < cols; j++) {
-				os << setw(static_cast<streamsize>(width)) << m(i, j);
-			}
-			os << endl;
+		(ostream &os, const MatrixView &v) {
+		return printMatrix(os, v);
+	}
+
+private:
+	template<typename, int, int> friend class MatrixView;
+	constexpr MatrixView() = default;
+
+	T const *base;
+	ptrdiff_t rs;
+	ptrdiff_t cs;
+	bool linear;
+	array<ptrdiff_t, rows> rowOffsets;
+	array<ptrdiff_t, cols> colOffsets;
+};
+
+// Storage is one of the policies in ex_4_matrix_storage.h. They all keep the
+// elements row-major with ld elements between rows, so operator() and the
+// kernels don't care which one is in use.
+//
+// With InlineStorage (the default for small sizes) everything but printing is
+// constexpr, so constant matrices, their products and determinants can be
+// computed by the compiler. Inside a constant expression the operators take
+// plain loops instead of the SIMD/GEMM kernels and determinant() uses plain
+// elimination instead of blocked LU; see the static_asserts in ex_4_PSMatrix.cpp.
+template<typename T, int rows, int cols = rows, template<typename, int, int> class Storage = DefaultStorage>
+class MatrixCommon {
+public:
+	using value_type = T;
+	static constexpr int nrows = rows;
+	static constexpr int ncols = cols;
+	static constexpr ptrdiff_t ld = Storage<T, rows, cols>::ld;
+
+	constexpr MatrixCommon(initializer_list<initializer_list<T>> init) {
+		int i = 0;
+		for (auto row : init) {
+			std::copy(row.begin(), row.end(), storage() + i * ld);
+			i++;
 		}
-		os << "]" << endl;
-		return os;
 	}
+	constexpr MatrixCommon() = default;
+	// Heap storage only: take over a rows x ld buffer without allocating one
+	explicit MatrixCommon(mpcs51044::AlignedArray<T> p) requires std::is_constructible_v<Storage<T, rows, cols>, mpcs51044::AlignedArray<T>>
+		: elements(std::move(p)) {}
 
-protected:
-	static size_t accumulateMax(size_t acc, T d) {
-		ostringstream ostr;
-		ostr << d;
-		return std::max(acc, ostr.str().size());
+	// Materialize a view; a transposed view goes through the transpose kernel
+	constexpr explicit MatrixCommon(MatrixView<T, rows, cols> const &v) {
+		if (v.strided() && v.colStride() == 1) {
+			for (int i = 0; i < rows; i++)
+				std::copy(v.origin() + i * v.rowStride(), v.origin() + i * v.rowStride() + cols, storage() + i * ld);
+		} else if (v.strided() && v.rowStride() == 1 && !std::is_constant_evaluated()) {
+			mpcs51044::simdKernels<T>().transpose(cols, rows, v.origin(), v.colStride(), storage(), ld);
+		} else {
+			for (int i = 0; i < rows; i++)
+				for (int j = 0; j < cols; j++)
+					(*this)(i, j) = v(i, j);
+		}
 	}
-	static size_t accumulateMaxRow(size_t acc, array<T, cols> row) {
-		return std::max(acc, accumulate(row.begin(), row.end(), static_cast<size_t>(0), accumulateMax));
+	constexpr T &operator()(int x, int y) {
+		return elements.data()[x * ld + y];
 	}
-	size_t longestElementSize() const {
-		return accumulate(data.begin(), data.end(), 0, accumulateMaxRow);
+
+	constexpr T operator()(int x, int y) const {
+		return elements.data()[x * ld + y];
+	}
+
+	// Row-major element storage (ld apart), for the kernels
+	constexpr T *storage() {
+		return elements.data();
+	}
+	constexpr T const *storage() const {
+		return elements.data();
+	}
+
+	// Heap storage policies can give their buffer to, or take one over from,
+	// a DynamicMatrix (ex_4_dynamic_matrix.h), so converting doesn't copy.
+	// Either way the elements are rows x ld.
+	mpcs51044::AlignedArray<T> releaseStorage() requires requires(Storage<T, rows, cols> &s) { s.release(); } {
+		return elements.release();
 	}
-	array<array<T, cols>, rows> data;
+	void adoptStorage(mpcs51044::AlignedArray<T> p) requires requires(Storage<T, rows, cols> &s) { s.release(); } {
+		elements.adopt(std::move(p));
+	}
+
+	constexpr MatrixView<T, rows, cols> view() const {
+		return { storage(), ld, 1 };
+	}
+
+	// Zero-copy; wrap in a Matrix to get an independent copy
+	constexpr MatrixView<T, cols, rows> transpose() const {
+		return view().transpose();
+	}
+
+	template<int r, int c>
+	constexpr MatrixView<T, r, c> block(int i, int j) const {
+		return view().template block<r, c>(i, j);
+	}
+
+	constexpr MatrixView<T, rows - 1, cols - 1> minor(int r, int c) const {
+		return view().minor(r, c);
+	}
+
+	inline friend
+		ostream &
+		operator<<
+		(ostream &os, const MatrixCommon &m) {
+		return printMatrix(os, m);
+	}
+
+protected:
+	Storage<T, rows, cols> elements;
 };
 
 
-template<typename T, int rows, int cols = rows>
-class Matrix : public MatrixCommon < T, rows, cols > {
+template<typename T, int rows, int cols, template<typename, int, int> class Storage>
+class Matrix : public MatrixCommon < T, rows, cols, Storage > {
 public:
-	Matrix() = default;
-	Matrix(initializer_list<initializer_list<T>> init) : MatrixCommon<T, rows, cols>(init) {}
-
-	Matrix<T, rows - 1, cols - 1> minor(int r, int c) const {
-		Matrix<T, rows - 1, cols - 1> result;
-		for (int i = 0; i < rows; i++) {
-			if (i == r) {
-				continue;
-			}
-			for (int j = 0; j < cols; j++) {
-				if (j == c) {
-					continue;
-				}
-				result(i < r ? i : i - 1, j < c ? j : j - 1) = this->data[i][j];
-			}
-		}
-		return result;
+	constexpr Matrix() = default;
+	constexpr Matrix(initializer_list<initializer_list<T>> init) : MatrixCommon<T, rows, cols, Storage>(init) {}
+	constexpr Matrix(MatrixView<T, rows, cols> const &v) : MatrixCommon<T, rows, cols, Storage>(v) {}
+	explicit Matrix(mpcs51044::AlignedArray<T> p) requires std::is_constructible_v<Storage<T, rows, cols>, mpcs51044::AlignedArray<T>>
+		: MatrixCommon<T, rows, cols, Storage>(std::move(p)) {}
+	// P*A = L*U, reusable for several determinants/solves of the same matrix
+	mpcs51044::LUDecomposition<T, rows> factorize() const {
+		static_assert(rows == cols, "Only square matrices can be factored");
+		return { this->storage(), this->ld };
 	}
-	T determinant() const {
-		T val = 0;
-		for (int i = 0; i < rows; i++) {
-			val += (i % 2 ? -1 : 1)
-				* MatrixCommon<T, rows, cols>::data[i][0]
-				* minor(i, 0).determinant();
+
+	// A = L*L^T, for symmetric positive definite matrices
+	mpcs51044::CholeskyDecomposition<T, rows> cholesky() const {
+		static_assert(rows == cols, "Only square matrices can be factored");
+		return { this->storage(), this->ld };
+	}
+
+	constexpr T determinant() const {
+		if constexpr (std::is_floating_point_v<T> && rows > 3) {
+			// O(n^3) instead of O(n!) cofactor expansion
+			if (std::is_constant_evaluated())
+				return mpcs51044::eliminationDeterminant<T>(rows, *this);
+			return factorize().determinant();
+		} else if constexpr (std::is_integral_v<T> && rows > 3) {
+			// Exact, and O(n^3) too
+			return mpcs51044::bareissDeterminant<T>(rows, *this);
+		} else {
+			// Closed forms, or cofactors for other element types
+			return cofactorDeterminant(*this);
 		}
-		return val;
 	}
 };
 
-template<typename T>
-class Matrix<T, 1, 1> : public MatrixCommon < T, 1, 1 > {
+template<typename T, template<typename, int, int> class Storage>
+class Matrix<T, 1, 1, Storage> : public MatrixCommon < T, 1, 1, Storage > {
 public:
-	Matrix() = default;
-	Matrix(initializer_list<initializer_list<T>> init) : MatrixCommon<T, 1, 1>(init) {}
+	constexpr Matrix() = default;
+	constexpr Matrix(initializer_list<initializer_list<T>> init) : MatrixCommon<T, 1, 1, Storage>(init) {}
+	constexpr Matrix(MatrixView<T, 1, 1> const &v) : MatrixCommon<T, 1, 1, Storage>(v) {}
+	explicit Matrix(mpcs51044::AlignedArray<T> p) requires std::is_constructible_v<Storage<T, 1, 1>, mpcs51044::AlignedArray<T>>
+		: MatrixCommon<T, 1, 1, Storage>(std::move(p)) {}
 
-	T determinant() const {
-		return this->data[0][0];
+	constexpr T determinant() const {
+		return (*this)(0, 0);
 	}
 };
 
-template<typename T, int a, int b, int c>
-inline Matrix<T, a, c>
-operator*(Matrix<T, a, b> const &l, Matrix<T, b, c> const &r)
+// The result uses the left operand's storage policy
+template<typename T, int a, int b, int c,
+	template<typename, int, int> class S1, template<typename, int, int> class S2>
+constexpr Matrix<T, a, c, S1>
+operator*(Matrix<T, a, b, S1> const &l, Matrix<T, b, c, S2> const &r)
 {
-	Matrix<T, a, c> result;
-	for (int i = 0; i < a; i++) {
-		for (int j = 0; j < c; j++) {
-			T total = 0;
-			for (int k = 0; k < b; k++)
-				total += l(i, k) * r(k, j);
-			result(i, j) = total;
-		}
+	Matrix<T, a, c, S1> result;
+	mpcs51044::multiplyInto<T, a, b, c>(
+		mpcs51044::rowMajor(l.storage(), l.ld),
+		mpcs51044::rowMajor(r.storage(), r.ld),
+		result.storage(), result.ld);
+	return result;
+}
+
+// Anything the multiply kernel can read: a Matrix or a MatrixView
+template<typename M>
+concept MatrixOperand = requires(M const &m) {
+	typename M::value_type;
+	{ M::nrows } -> std::convertible_to<int>;
+	{ M::ncols } -> std::convertible_to<int>;
+	{ m(0, 0) } -> std::convertible_to<typename M::value_type>;
+};
+
+template<typename M>
+inline constexpr bool isMatrixView = false;
+template<typename T, int rows, int cols>
+inline constexpr bool isMatrixView<MatrixView<T, rows, cols>> = true;
+
+// Products involving a view read the viewed elements in place
+template<MatrixOperand L, MatrixOperand R>
+	requires (isMatrixView<L> || isMatrixView<R>)
+constexpr Matrix<typename L::value_type, L::nrows, R::ncols>
+operator*(L const &l, R const &r)
+{
+	using T = typename L::value_type;
+	static_assert(L::ncols == R::nrows, "Inner Matrix dimensions must match");
+	Matrix<T, L::nrows, R::ncols> result;
+	mpcs51044::multiplyInto<T, L::nrows, L::ncols, R::ncols>(l, r, result.storage(), result.ld);
+	return result;
+}
+
+template<typename T, int a, int b,
+	template<typename, int, int> class S1, template<typename, int, int> class S2>
+constexpr Matrix<T, a, b, S1>
+operator+(Matrix<T, a, b, S1> const &l, Matrix<T, a, b, S2> const &r)
+{
+	Matrix<T, a, b, S1> result;
+	if (std::is_constant_evaluated()) {
+		for (int i = 0; i < a; i++)
+			for (int j = 0; j < b; j++)
+				result(i, j) = l(i, j) + r(i, j);
+		return result;
+	}
+	auto add = mpcs51044::simdKernels<T>().add;
+	if (l.ld == b && r.ld == b) {
+		add(a * b, l.storage(), r.storage(), result.storage());
+	} else {
+		for (int i = 0; i < a; i++)
+			add(b, l.storage() + i * l.ld, r.storage() + i * r.ld, result.storage() + i * result.ld);
+	}
+	return result;
+}
+
+template<typename T, int a, int b, template<typename, int, int> class S>
+constexpr Matrix<T, a, b, S>
+operator*(T s, Matrix<T, a, b, S> const &m)
+{
+	Matrix<T, a, b, S> result;
+	if (std::is_constant_evaluated()) {
+		for (int i = 0; i < a; i++)
+			for (int j = 0; j < b; j++)
+				result(i, j) = s * m(i, j);
+		return result;
+	}
+	auto scale = mpcs51044::simdKernels<T>().scale;
+	if (m.ld == b) {
+		scale(a * b, s, m.storage(), result.storage());
+	} else {
+		for (int i = 0; i < a; i++)
+			scale(b, s, m.storage() + i * m.ld, result.storage() + i * result.ld);
 	}
 	return result;
 }
+
+template<typename T, int a, int b, template<typename, int, int> class S>
+constexpr Matrix<T, a, b, S>
+operator*(Matrix<T, a, b, S> const &m, T s)
+{
+	return s * m;
+}
 }
 #endif
\ No newline at end of file
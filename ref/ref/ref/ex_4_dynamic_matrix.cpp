@@ -0,0 +1,49 @@
+#include "ex_4_dynamic_matrix.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+using namespace mpcs51044_ps;
+using namespace std;
+
+// ex_4_dynamic_matrix [n]: an n x n product and determinant with n chosen at runtime
+int main(int argc, char **argv)
+{
+	int const n = argc > 1 ? atoi(argv[1]) : 512;
+	DynamicMatrix<double> a(n, n), b(n, n);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			a(i, j) = (i == j) + 1.0 / (i + j + 1);
+			b(i, j) = (i + 2 * j) % 7;
+		}
+	}
+	auto start = chrono::steady_clock::now();
+	DynamicMatrix<double> c = a * b;
+	cout << n << "x" << n << " multiply: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	cout << "determinant: " << a.determinant() << '\n';
+
+	DynamicMatrix<int> small = {
+		{ 2, 0, 0, 1, },
+		{ 0, 3, 0, 0, },
+		{ 0, 0, 4, 0, },
+		{ 1, 0, 0, 5, }
+	};
+	cout << small << small.transpose() * small << small.determinant() << endl;
+	cout << "determinant of a 0x0 matrix: " << DynamicMatrix<int>{}.determinant() << endl;
+
+	// Heap-stored fixed-size matrices and DynamicMatrix share one layout,
+	// so converting between them moves the buffer instead of copying it
+	auto fixed = make_unique<Matrix<double, 512, 512, PaddedStorage>>();
+	double const *elements = fixed->storage();
+	DynamicMatrix<double> dynamic(std::move(*fixed));
+	cout << "to DynamicMatrix copied: " << (dynamic.storage() != elements ? "yes" : "no") << ", ld " << dynamic.ld() << '\n';
+	auto back = std::move(dynamic).toMatrix<512, 512, PaddedStorage>();
+	cout << "back to Matrix copied: " << (back.storage() != elements ? "yes" : "no") << endl;
+
+	// A moved-from DynamicMatrix is 0x0, so it can still be copied and printed
+	DynamicMatrix<int> taken(std::move(small));
+	DynamicMatrix<int> copyOfEmpty(small);
+	cout << "moved from: " << small.rows() << "x" << small.cols() << ", its copy: "
+		<< copyOfEmpty.rows() << "x" << copyOfEmpty.cols() << ", moved to: " << taken.rows() << "x" << taken.cols() << '\n'
+		<< copyOfEmpty;
+}
@@ -0,0 +1,269 @@
+#ifndef DYNAMIC_MATRIX_H
+#  define DYNAMIC_MATRIX_H
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "ex_4_PSMatrix.h"
+#include "ex_4_matrix_bareiss.h"
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_lu.h"
+#include "ex_4_matrix_cholesky.h"
+#include "ex_4_matrix_simd.h"
+#include "ex_4_matrix_storage.h"
+
+using std::initializer_list;
+using std::ptrdiff_t;
+
+//////////////////////////////////////////
+// RUNTIME-SIZED MATRICES
+//////////////////////////////////////////
+// Matrix<T, rows, cols> needs its size at compile time, so every shape is a
+// separate instantiation and a size read from a file can't be used at all.
+// DynamicMatrix<T> takes its size as constructor arguments. Its elements are
+// laid out exactly like a heap-stored Matrix (cache line aligned, row-major,
+// ld elements between rows), so it runs the same tiled multiply, LU and
+// transpose kernels, and converting to or from a Matrix with HeapStorage or
+// PaddedStorage just hands the buffer over when the sizes match.
+//
+// Size mismatches can only be found at runtime and throw
+// std::invalid_argument.
+
+namespace mpcs51044_ps {
+
+template<typename T>
+class DynamicMatrix {
+public:
+	using value_type = T;
+
+	DynamicMatrix() : nr(0), nc(0), stride(0), elements(mpcs51044::allocateAligned<T>(0)) {}
+
+	// rows x cols zeros; padded rounds ld up the way PaddedStorage does
+	DynamicMatrix(int rows, int cols, bool padded = false)
+		: nr(checkDimension(rows)), nc(checkDimension(cols)),
+		  stride(padded ? mpcs51044::paddedLeadingDimension<T>(cols) : cols),
+		  elements(mpcs51044::allocateAligned<T>(static_cast<size_t>(rows) * stride)) {}
+
+	DynamicMatrix(initializer_list<initializer_list<T>> init)
+		: DynamicMatrix(static_cast<int>(init.size()), init.size() ? static_cast<int>(init.begin()->size()) : 0) {
+		int i = 0;
+		for (auto row : init) {
+			if (static_cast<int>(row.size()) != nc)
+				throw std::invalid_argument("Every row of a Matrix needs the same number of elements");
+			std::copy(row.begin(), row.end(), storage() + i * stride);
+			i++;
+		}
+	}
+
+	DynamicMatrix(DynamicMatrix const &other) : DynamicMatrix(other.nr, other.nc) {
+		copyFrom(other.storage(), other.stride);
+	}
+	DynamicMatrix &operator=(DynamicMatrix const &other) {
+		if (this != &other)
+			*this = DynamicMatrix(other);
+		return *this;
+	}
+	// Moves take the buffer and leave other 0 x 0
+	DynamicMatrix(DynamicMatrix &&other) noexcept
+		: nr(std::exchange(other.nr, 0)), nc(std::exchange(other.nc, 0)),
+		  stride(std::exchange(other.stride, 0)), elements(std::move(other.elements)) {}
+	DynamicMatrix &operator=(DynamicMatrix &&other) noexcept {
+		if (this != &other) {
+			nr = std::exchange(other.nr, 0);
+			nc = std::exchange(other.nc, 0);
+			stride = std::exchange(other.stride, 0);
+			elements = std::move(other.elements);
+		}
+		return *this;
+	}
+
+	// Copy a fixed-size Matrix (or anything else laid out row-major)
+	template<int rows, int cols, template<typename, int, int> class S>
+	explicit DynamicMatrix(Matrix<T, rows, cols, S> const &m) : DynamicMatrix(rows, cols) {
+		copyFrom(m.storage(), m.ld);
+	}
+
+	// A heap-stored Matrix gives up its buffer instead (keeping its ld)
+	template<int rows, int cols, template<typename, int, int> class S>
+	explicit DynamicMatrix(Matrix<T, rows, cols, S> &&m) {
+		if constexpr (requires { m.releaseStorage(); }) {
+			nr = rows;
+			nc = cols;
+			stride = m.ld;
+			elements = m.releaseStorage();
+		} else {
+			*this = DynamicMatrix(static_cast<Matrix<T, rows, cols, S> const &>(m));
+		}
+	}
+
+	// The fixed-size Matrix with the same elements
+	template<int rows, int cols, template<typename, int, int> class S = DefaultStorage>
+	Matrix<T, rows, cols, S> toMatrix() const & {
+		checkSize(rows, cols);
+		Matrix<T, rows, cols, S> result;
+		for (int i = 0; i < rows; i++)
+			std::copy(storage() + i * stride, storage() + i * stride + cols, result.storage() + i * result.ld);
+		return result;
+	}
+
+	// Same, but a heap-stored Matrix with the same ld takes over the buffer
+	// and this is left empty (0 x 0)
+	template<int rows, int cols, template<typename, int, int> class S = DefaultStorage>
+	Matrix<T, rows, cols, S> toMatrix() && {
+		using Result = Matrix<T, rows, cols, S>;
+		checkSize(rows, cols);
+		if constexpr (std::is_constructible_v<Result, mpcs51044::AlignedArray<T>>) {
+			if (stride == Result::ld) {
+				Result result(std::move(elements));
+				*this = DynamicMatrix();
+				return result;
+			}
+		}
+		return static_cast<DynamicMatrix const &>(*this).template toMatrix<rows, cols, S>();
+	}
+
+	int rows() const {
+		return nr;
+	}
+	int cols() const {
+		return nc;
+	}
+	// Elements between the starts of consecutive rows
+	ptrdiff_t ld() const {
+		return stride;
+	}
+
+	T &operator()(int x, int y) {
+		return elements.get()[x * stride + y];
+	}
+	T operator()(int x, int y) const {
+		return elements.get()[x * stride + y];
+	}
+
+	// Row-major element storage (ld() apart), for the kernels
+	T *storage() {
+		return elements.get();
+	}
+	T const *storage() const {
+		return elements.get();
+	}
+
+	DynamicMatrix transpose() const {
+		DynamicMatrix result(nc, nr);
+		mpcs51044::simdKernels<T>().transpose(nr, nc, storage(), stride, result.storage(), result.stride);
+		return result;
+	}
+
+	// P*A = L*U, reusable for several determinants/solves
+	mpcs51044::LUDecomposition<T> factorize() const {
+		checkSquare();
+		return { nr, storage(), stride };
+	}
+
+	// A = L*L^T, for symmetric positive definite matrices
+	mpcs51044::CholeskyDecomposition<T> cholesky() const {
+		checkSquare();
+		return { nr, storage(), stride };
+	}
+
+	// LU for floating point, exact (Bareiss) for integral element types
+	T determinant() const {
+		checkSquare();
+		if constexpr (std::is_integral_v<T>) {
+			return mpcs51044::bareissDeterminant<T>(nr, *this);
+		} else {
+			return factorize().determinant();
+		}
+	}
+
+	inline friend
+		ostream &
+		operator<<
+		(ostream &os, const DynamicMatrix &m) {
+		return printMatrix(os, m, m.rows(), m.cols());
+	}
+
+	inline friend
+		DynamicMatrix
+		operator*
+		(DynamicMatrix const &l, DynamicMatrix const &r) {
+		if (l.nc != r.nr)
+			throw std::invalid_argument("Inner Matrix dimensions must match");
+		DynamicMatrix result(l.nr, r.nc);
+		mpcs51044::multiplyInto<T>(l.nr, l.nc, r.nc,
+			mpcs51044::rowMajor(l.storage(), l.stride),
+			mpcs51044::rowMajor(r.storage(), r.stride),
+			result.storage(), result.stride);
+		return result;
+	}
+
+	inline friend
+		DynamicMatrix
+		operator+
+		(DynamicMatrix const &l, DynamicMatrix const &r) {
+		if (l.nr != r.nr || l.nc != r.nc)
+			throw std::invalid_argument("Matrix sizes must match");
+		DynamicMatrix result(l.nr, l.nc);
+		auto add = mpcs51044::simdKernels<T>().add;
+		if (l.stride == l.nc && r.stride == r.nc) {
+			add(static_cast<size_t>(l.nr) * l.nc, l.storage(), r.storage(), result.storage());
+		} else {
+			for (int i = 0; i < l.nr; i++)
+				add(l.nc, l.storage() + i * l.stride, r.storage() + i * r.stride, result.storage() + i * result.stride);
+		}
+		return result;
+	}
+
+	inline friend
+		DynamicMatrix
+		operator*
+		(T s, DynamicMatrix const &m) {
+		DynamicMatrix result(m.nr, m.nc);
+		auto scale = mpcs51044::simdKernels<T>().scale;
+		if (m.stride == m.nc) {
+			scale(static_cast<size_t>(m.nr) * m.nc, s, m.storage(), result.storage());
+		} else {
+			for (int i = 0; i < m.nr; i++)
+				scale(m.nc, s, m.storage() + i * m.stride, result.storage() + i * result.stride);
+		}
+		return result;
+	}
+
+	inline friend
+		DynamicMatrix
+		operator*
+		(DynamicMatrix const &m, T s) {
+		return s * m;
+	}
+
+private:
+	void copyFrom(T const *src, ptrdiff_t ldSrc) {
+		for (int i = 0; i < nr; i++)
+			std::copy(src + i * ldSrc, src + i * ldSrc + nc, storage() + i * stride);
+	}
+	// Runs in the constructor's initializer list, so a bad size throws before
+	// anything is allocated
+	static int checkDimension(int n) {
+		if (n < 0)
+			throw std::invalid_argument("Matrix dimensions can't be negative");
+		return n;
+	}
+	void checkSize(int rows, int cols) const {
+		if (rows != nr || cols != nc)
+			throw std::invalid_argument("Matrix sizes must match");
+	}
+	void checkSquare() const {
+		if (nr != nc)
+			throw std::invalid_argument("Sorry, only square matrices have determinants");
+	}
+
+	int nr;
+	int nc;
+	ptrdiff_t stride;
+	mpcs51044::AlignedArray<T> elements;
+};
+
+}
+#endif
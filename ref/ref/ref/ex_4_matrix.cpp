@@ -4,6 +4,33 @@
 using namespace mpcs51044_norm;
 using namespace std;
 
+// Constant matrices, their products and determinants are computed by the
+// compiler: none of this would compile otherwise
+constexpr Matrix<3, 3> turn = {
+		{ 0, -1, 0, },
+		{ 1,  0, 0, },
+		{ 0,  0, 1, }
+};
+constexpr Matrix<3, 3> scale = {
+		{ 2, 0, 0, },
+		{ 0, 3, 0, },
+		{ 0, 0, 4, }
+};
+constexpr Matrix<3, 3> turnScale = turn * scale;
+static_assert(turnScale(0, 1) == -3 && turnScale(1, 0) == 2 && turnScale(2, 2) == 4);
+static_assert(turn.determinant() == 1);
+static_assert(turnScale.determinant() == 24);
+static_assert(Matrix<3, 3>(turnScale - 2.0 * turnScale + scale)(1, 0) == -2);
+constexpr Matrix<4, 4> four = {
+		{ 2, 0, 0, 1, },
+		{ 0, 3, 0, 0, },
+		{ 0, 0, 4, 0, },
+		{ 1, 0, 0, 5, }
+};
+static_assert(four.determinant() == 108);
+static_assert(four.minor(3, 3).determinant() == 24);
+static_assert(Matrix<4, 4>(four * four)(0, 0) == 5);
+
 int main()
 {
 	auto start = chrono::system_clock::now();
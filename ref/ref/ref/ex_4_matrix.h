@@ -8,6 +8,11 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <type_traits>
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_lu.h"
+#include "ex_4_matrix_cholesky.h"
+#include "ex_4_matrix_format.h"
 
 #undef minor // Some compilers have a macro named minor
 
@@ -27,36 +32,306 @@ using std::max;
 
 namespace mpcs51044_norm {
 
+//////////////////////////////////////////
+// EXPRESSION TEMPLATES
+//////////////////////////////////////////
+// +, - and scalar * don't compute anything: they return small nodes that
+// remember their operands, so A*B + C*D + E builds a tree of nodes instead of
+// four full temporaries. The work happens when the tree is assigned to a
+// Matrix:
+//   - an elementwise tree (no product in it) is evaluated in a single pass,
+//     dst[i] = f(a[i], b[i], ...)
+//   - otherwise the elementwise part seeds dst and every product is
+//     accumulated into it by the GEMM kernel (dst += alpha * A * B), so
+//     C = A*B + C is a single fused multiply-add
+//
+// Every node provides
+//   nrows, ncols    its shape
+//   elementwise     true if no product occurs in it
+//   coeff(i)        element i in row-major order (elementwise nodes only)
+//   assignInto(dst, alpha)      dst  = alpha * node
+//   accumulateInto(dst, alpha)  dst += alpha * node
+//   aliases(dst, written)       whether evaluating into dst would read dst
+//                               after an earlier pass has already written it
+//
+// All of it is constexpr: in a constant expression the products take the
+// plain loop in multiplySimple() instead of the GEMM kernel.
+
+template<int rows, int cols> class Matrix;
+
+// CRTP base that lets the operators below accept any node (or a Matrix)
+template<typename E>
+struct MatrixExpr {
+	constexpr E const &self() const {
+		return static_cast<E const &>(*this);
+	}
+
+	constexpr void assignElementwise(double *dst, double alpha) const {
+		for (int i = 0; i < E::nrows * E::ncols; i++)
+			dst[i] = alpha * self().coeff(i);
+	}
+	constexpr void accumulateElementwise(double *dst, double alpha) const {
+		for (int i = 0; i < E::nrows * E::ncols; i++)
+			dst[i] += alpha * self().coeff(i);
+	}
+};
+
+template<typename E>
+struct IsMatrix : std::false_type {};
+template<int rows, int cols>
+struct IsMatrix<Matrix<rows, cols>> : std::true_type {};
+
+// Matrices are held by reference, nodes (which are tiny) by value
+template<typename E>
+using ExprHolder = std::conditional_t<IsMatrix<E>::value, E const &, E const>;
+
+template<typename L, typename R>
+struct MatrixSum : MatrixExpr<MatrixSum<L, R>> {
+	static_assert(L::nrows == R::nrows && L::ncols == R::ncols, "Matrix sizes must match");
+	static constexpr int nrows = L::nrows;
+	static constexpr int ncols = L::ncols;
+	static constexpr bool elementwise = L::elementwise && R::elementwise;
+
+	constexpr MatrixSum(L const &l, R const &r) : l(l), r(r) {}
+
+	constexpr double coeff(int i) const {
+		return l.coeff(i) + r.coeff(i);
+	}
+	// Elementwise operands go first so that C = A*B + C reads C before writing it
+	constexpr void assignInto(double *dst, double alpha) const {
+		if constexpr (elementwise) {
+			this->assignElementwise(dst, alpha);
+		} else if constexpr (R::elementwise) {
+			r.assignInto(dst, alpha);
+			l.accumulateInto(dst, alpha);
+		} else {
+			l.assignInto(dst, alpha);
+			r.accumulateInto(dst, alpha);
+		}
+	}
+	constexpr void accumulateInto(double *dst, double alpha) const {
+		if constexpr (elementwise) {
+			this->accumulateElementwise(dst, alpha);
+		} else if constexpr (R::elementwise) {
+			r.accumulateInto(dst, alpha);
+			l.accumulateInto(dst, alpha);
+		} else {
+			l.accumulateInto(dst, alpha);
+			r.accumulateInto(dst, alpha);
+		}
+	}
+	constexpr bool aliases(double const *dst, bool written) const {
+		if constexpr (elementwise) {
+			return l.aliases(dst, written) || r.aliases(dst, written);
+		} else if constexpr (R::elementwise) {
+			return r.aliases(dst, written) || l.aliases(dst, true);
+		} else {
+			return l.aliases(dst, written) || r.aliases(dst, true);
+		}
+	}
+
+	ExprHolder<L> l;
+	ExprHolder<R> r;
+};
+
+// l - r is l + (-1) * r
+template<typename L, typename R>
+struct MatrixDifference : MatrixExpr<MatrixDifference<L, R>> {
+	static_assert(L::nrows == R::nrows && L::ncols == R::ncols, "Matrix sizes must match");
+	static constexpr int nrows = L::nrows;
+	static constexpr int ncols = L::ncols;
+	static constexpr bool elementwise = L::elementwise && R::elementwise;
+
+	constexpr MatrixDifference(L const &l, R const &r) : l(l), r(r) {}
+
+	constexpr double coeff(int i) const {
+		return l.coeff(i) - r.coeff(i);
+	}
+	constexpr void assignInto(double *dst, double alpha) const {
+		if constexpr (elementwise) {
+			this->assignElementwise(dst, alpha);
+		} else if constexpr (R::elementwise) {
+			r.assignInto(dst, -alpha);
+			l.accumulateInto(dst, alpha);
+		} else {
+			l.assignInto(dst, alpha);
+			r.accumulateInto(dst, -alpha);
+		}
+	}
+	constexpr void accumulateInto(double *dst, double alpha) const {
+		if constexpr (elementwise) {
+			this->accumulateElementwise(dst, alpha);
+		} else if constexpr (R::elementwise) {
+			r.accumulateInto(dst, -alpha);
+			l.accumulateInto(dst, alpha);
+		} else {
+			l.accumulateInto(dst, alpha);
+			r.accumulateInto(dst, -alpha);
+		}
+	}
+	constexpr bool aliases(double const *dst, bool written) const {
+		if constexpr (elementwise) {
+			return l.aliases(dst, written) || r.aliases(dst, written);
+		} else if constexpr (R::elementwise) {
+			return r.aliases(dst, written) || l.aliases(dst, true);
+		} else {
+			return l.aliases(dst, written) || r.aliases(dst, true);
+		}
+	}
+
+	ExprHolder<L> l;
+	ExprHolder<R> r;
+};
+
+template<typename E>
+struct MatrixScaled : MatrixExpr<MatrixScaled<E>> {
+	static constexpr int nrows = E::nrows;
+	static constexpr int ncols = E::ncols;
+	static constexpr bool elementwise = E::elementwise;
+
+	constexpr MatrixScaled(double s, E const &e) : s(s), e(e) {}
+
+	constexpr double coeff(int i) const {
+		return s * e.coeff(i);
+	}
+	constexpr void assignInto(double *dst, double alpha) const {
+		e.assignInto(dst, alpha * s);
+	}
+	constexpr void accumulateInto(double *dst, double alpha) const {
+		e.accumulateInto(dst, alpha * s);
+	}
+	constexpr bool aliases(double const *dst, bool written) const {
+		return e.aliases(dst, written);
+	}
+
+	double s;
+	ExprHolder<E> e;
+};
+
+// Product operands: matrices by reference and elementwise nodes by value
+// (packing reads them through coeff(), so A * (B + C) needs no temporary);
+// anything containing another product is evaluated up front
+template<typename E>
+using ProductOperand = std::conditional_t<
+	IsMatrix<E>::value,
+	E const &,
+	std::conditional_t<E::elementwise, E const, Matrix<E::nrows, E::ncols>>>;
+
+// Adapts a node to the operator()(int, int) interface of the GEMM kernel
+template<typename E>
+struct ExprOperand {
+	E const &e;
+	constexpr double operator()(int i, int j) const {
+		return e.coeff(i * E::ncols + j);
+	}
+};
+
+template<typename L, typename R>
+struct MatrixProduct : MatrixExpr<MatrixProduct<L, R>> {
+	static_assert(L::ncols == R::nrows, "Inner Matrix dimensions must match");
+	static constexpr int nrows = L::nrows;
+	static constexpr int ncols = R::ncols;
+	static constexpr bool elementwise = false;
+
+	constexpr MatrixProduct(L const &l, R const &r) : l(l), r(r) {}
+
+	constexpr void assignInto(double *dst, double alpha) const {
+		if (alpha == 1) {
+			mpcs51044::multiplyInto<double, nrows, L::ncols, ncols>(operand(l), operand(r), dst, ncols);
+		} else {
+			std::fill(dst, dst + nrows * ncols, 0.0);
+			accumulateInto(dst, alpha);
+		}
+	}
+	constexpr void accumulateInto(double *dst, double alpha) const {
+		if (alpha == 1) {
+			mpcs51044::multiplyAccumulate<double, nrows, L::ncols, ncols>(operand(l), operand(r), dst, ncols);
+		} else {
+			mpcs51044::multiplyAccumulate<double, nrows, L::ncols, ncols>(
+				mpcs51044::ScaledOperand<double, decltype(operand(l))>{ alpha, operand(l) },
+				operand(r), dst, ncols);
+		}
+	}
+	// The kernel reads its operands while it writes dst, so any overlap is a hazard
+	constexpr bool aliases(double const *dst, bool) const {
+		return reads(l, dst) || reads(r, dst);
+	}
+
+	ProductOperand<L> l;
+	ProductOperand<R> r;
+
+private:
+	template<typename E>
+	static constexpr auto operand(E const &e) {
+		if constexpr (IsMatrix<E>::value) {
+			return mpcs51044::rowMajor(e.storage(), E::ncols);
+		} else {
+			return ExprOperand<E>{ e };
+		}
+	}
+	template<typename E>
+	static constexpr bool reads(E const &e, double const *dst) {
+		if constexpr (IsMatrix<E>::value || E::elementwise) {
+			return e.aliases(dst, true);
+		} else {
+			return false;
+		}
+	}
+};
+
 template<int rows, int cols = rows>
-class Matrix {
+class Matrix : public MatrixExpr<Matrix<rows, cols>> {
 public:
 	//////////////////////////////////////////
 	// STATIC_ASSERT: a way to generate readable errors when using templates improperly
 	//////////////////////////////////////////
 	static_assert(rows == cols,	"Sorry, only square matrices have determinants");
-	Matrix() : data{} {}
+	constexpr Matrix() : data{} {}
 
 	// constructor takes a std::initializer_list<T>, which
 	// represents a “braced initializer of Ts” expression
 
 	// Initializer lists have begin(), end(), and size()
 	// methods so your constructor can iterate through their value.
-	Matrix(initializer_list<initializer_list<double>> init) {
+	constexpr Matrix(initializer_list<initializer_list<double>> init) : data{} {
 		auto dp = data.begin();
 		for (auto row : init) {
-			std::copy(row.begin(), row.end(), dp->begin());
-			dp++;
+			std::copy(row.begin(), row.end(), dp);
+			dp += cols;
 		}
 	}
 
+	// Evaluate an expression straight into the new Matrix's storage
+	template<typename E>
+	constexpr Matrix(MatrixExpr<E> const &e) : data{} {
+		e.self().assignInto(storage(), 1.0);
+	}
+
+	template<typename E>
+	constexpr Matrix &operator=(MatrixExpr<E> const &e) {
+		if (e.self().aliases(storage(), false)) {
+			return throughCopy(e, [this](Matrix const &copy) { *this = copy; });
+		}
+		e.self().assignInto(storage(), 1.0);
+		return *this;
+	}
+
 	// operator() overload...fetch data
-	double &operator()(int x, int y) {
-		return data[x][y];
+	constexpr double &operator()(int x, int y) {
+		return data[x * cols + y];
 	}
 
 	// operator() overload...fetch data
-	double operator()(int x, int y) const {
-		return data[x][y];
+	constexpr double operator()(int x, int y) const {
+		return data[x * cols + y];
+	}
+
+	// Row-major element storage, for the kernels
+	constexpr double *storage() {
+		return data.data();
+	}
+	constexpr double const *storage() const {
+		return data.data();
 	}
 
 	// function to print itself
@@ -64,20 +339,11 @@ public:
 		ostream &
 		operator<<
 		(ostream &os, const Matrix<rows, cols> &m) {
-		size_t width = m.longestElementSize() + 2;
-		os << "[ " << endl;
-		for (int i = 0; i < rows; i++) {
-			for (int j = 0; j < cols; j++) {
-				os << setw(static_cast<streamsize>(width)) << m(i, j);
-			}
-			os << endl;
-		}
-		os << "]" << endl;
-		return os;
+		return mpcs51044::formatMatrix(os, m, rows, cols);
 	}
 
 	// minor()
-	Matrix<rows - 1, cols - 1> minor(int r, int c) const {
+	constexpr Matrix<rows - 1, cols - 1> minor(int r, int c) const {
 		Matrix<rows - 1, cols - 1> result;
 		for (int i = 0; i < rows; i++) {
 			if (i == r) {
@@ -87,89 +353,160 @@ public:
 				if (j == c) {
 					continue;
 				}
-				result(i < r ? i : i - 1, j < c ? j : j - 1) = data[i][j];
+				result(i < r ? i : i - 1, j < c ? j : j - 1) = (*this)(i, j);
 			}
 		}
 		return result;
 	}
 
-	// determinant()
-	double determinant() const {
-		double val = 0;
-		for (int i = 0; i < rows; i++) {
-			val += (i % 2 ? -1 : 1)
-				* data[i][0]
-				* minor(i, 0).determinant();
+	// factorize(): P*A = L*U, reusable for several determinants/solves
+	mpcs51044::LUDecomposition<double, rows> factorize() const {
+		return { storage(), cols };
+	}
+
+	// cholesky(): A = L*L^T for symmetric positive definite matrices
+	mpcs51044::CholeskyDecomposition<double, rows> cholesky() const {
+		return { storage(), cols };
+	}
+
+	// determinant(): O(n^3) through the LU factors rather than O(n!) cofactors
+	// (plain elimination in constant expressions, which can't run the kernels)
+	constexpr double determinant() const {
+		if (std::is_constant_evaluated()) {
+			return mpcs51044::eliminationDeterminant<double>(rows, *this);
 		}
-		return val;
+		return factorize().determinant();
 	}
 
-	// overload operator+()... for addition
-	Matrix &operator+=(Matrix const &other) {
-		*this = *this + other;
+	// overload operator+=()... accumulates in place, so C += A * B is one fused GEMM
+	template<typename E>
+	constexpr Matrix &operator+=(MatrixExpr<E> const &e) {
+		if (e.self().aliases(storage(), false)) {
+			return throughCopy(e, [this](Matrix const &copy) { *this += copy; });
+		}
+		e.self().accumulateInto(storage(), 1.0);
 		return *this;
 	}
 
-private:
-	static size_t accumulateMax(size_t acc, double d) {
-		ostringstream ostr;
-		ostr << d;
-		return std::max(acc, ostr.str().size());
+	template<typename E>
+	constexpr Matrix &operator-=(MatrixExpr<E> const &e) {
+		if (e.self().aliases(storage(), false)) {
+			return throughCopy(e, [this](Matrix const &copy) { *this -= copy; });
+		}
+		e.self().accumulateInto(storage(), -1.0);
+		return *this;
+	}
+
+	// Leaf node of the expression templates
+	static constexpr int nrows = rows;
+	static constexpr int ncols = cols;
+	static constexpr bool elementwise = true;
+
+	constexpr double coeff(int i) const {
+		return storage()[i];
 	}
-	static size_t accumulateMaxRow(size_t acc, array<double, cols> row) {
-		return std::max(acc, accumulate(row.begin(), row.end(), static_cast<size_t>(0), accumulateMax));
+	constexpr void assignInto(double *dst, double alpha) const {
+		if (alpha == 1)
+			std::copy(storage(), storage() + rows * cols, dst);
+		else if (std::is_constant_evaluated())
+			this->assignElementwise(dst, alpha);
+		else
+			mpcs51044::simdKernels<double>().scale(rows * cols, alpha, storage(), dst);
 	}
-	size_t longestElementSize() const {
-		return accumulate(data.begin(), data.end(), 0, accumulateMaxRow);
+	constexpr void accumulateInto(double *dst, double alpha) const {
+		this->accumulateElementwise(dst, alpha);
+	}
+	constexpr bool aliases(double const *dst, bool written) const {
+		return written && dst == storage();
+	}
+
+private:
+	// An expression that reads this Matrix can't be evaluated straight into
+	// it, so it is evaluated into a copy that f then applies. Matrices over
+	// 64KB make that copy on the heap (new works in constant expressions
+	// too) rather than on the stack
+	template<typename E, typename F>
+	constexpr Matrix &throughCopy(MatrixExpr<E> const &e, F f) {
+		if constexpr (sizeof(double) * rows * cols <= 64 * 1024) {
+			f(Matrix(e));
+		} else {
+			Matrix const *copy = new Matrix(e);
+			f(*copy);
+			delete copy;
+		}
+		return *this;
 	}
-	array<array<double, cols>, rows> data;
+
+	// One flat row-major array rather than an array of rows, so that
+	// storage() can walk all of it (also in constant expressions)
+	array<double, rows * cols> data;
 };
 
 // template specialization: implement specialized method for a Matrix<1,1>
 template<>
-double
+constexpr double
 Matrix<1, 1>::determinant() const
 {
-	return data[0][0];
+	return data[0];
 }
 
 // template specialization: implement specialized method for a Matrix<2,2>
 template<>
-double
+constexpr double
 Matrix<2, 2>::determinant() const
 {
-	return data[0][0]*data[1][1] - data[1][0]*data[0][1];
+	auto const &d = *this;
+	return d(0, 0)*d(1, 1) - d(1, 0)*d(0, 1);
 }
 
-// overload operator*()... for multiplication
-template<int a, int b, int c>
-inline Matrix<a, c>
-operator*(Matrix<a, b> const &l, Matrix<b, c> const &r)
+// template specialization: implement specialized method for a Matrix<3,3>
+template<>
+constexpr double
+Matrix<3, 3>::determinant() const
 {
-	Matrix<a, c> result;
-	for (int i = 0; i < a; i++) {
-		for (int j = 0; j < c; j++) {
-			double total = 0;
-			for (int k = 0; k < b; k++)
-				total += l(i, k) * r(k, j);
-			result(i, j) = total;
-		}
-	}
-	return result;
+	auto const &d = *this;
+	return d(0, 0)*(d(1, 1)*d(2, 2) - d(1, 2)*d(2, 1))
+		- d(0, 1)*(d(1, 0)*d(2, 2) - d(1, 2)*d(2, 0))
+		+ d(0, 2)*(d(1, 0)*d(2, 1) - d(1, 1)*d(2, 0));
 }
 
-// overload operator+()... for addition
-template<int a, int b>
-inline Matrix<a, b>
-operator+(Matrix<a, b> const &l, Matrix<a, b> const &r)
+// overload operator*()... for multiplication (lazy; evaluated on assignment)
+template<typename L, typename R>
+constexpr MatrixProduct<L, R>
+operator*(MatrixExpr<L> const &l, MatrixExpr<R> const &r)
 {
-	Matrix<a, b> result;
-	for (int i = 0; i < a; i++) {
-		for (int j = 0; j < c; j++) {
-			result(i, j) = l(i,j) + r(i,j);
-		}
-	}
-	return result;
+	return { l.self(), r.self() };
+}
+
+// overload operator+()... for addition (lazy)
+template<typename L, typename R>
+constexpr MatrixSum<L, R>
+operator+(MatrixExpr<L> const &l, MatrixExpr<R> const &r)
+{
+	return { l.self(), r.self() };
+}
+
+// overload operator-()... for subtraction (lazy)
+template<typename L, typename R>
+constexpr MatrixDifference<L, R>
+operator-(MatrixExpr<L> const &l, MatrixExpr<R> const &r)
+{
+	return { l.self(), r.self() };
+}
+
+// overload operator*()... for scaling by a number (lazy)
+template<typename E>
+constexpr MatrixScaled<E>
+operator*(double s, MatrixExpr<E> const &e)
+{
+	return { s, e.self() };
+}
+
+template<typename E>
+constexpr MatrixScaled<E>
+operator*(MatrixExpr<E> const &e, double s)
+{
+	return { s, e.self() };
 }
 
 }
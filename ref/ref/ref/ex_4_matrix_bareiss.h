@@ -0,0 +1,80 @@
+#ifndef MATRIX_BAREISS_H
+#  define MATRIX_BAREISS_H
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+using std::vector;
+
+//////////////////////////////////////////
+// EXACT INTEGER DETERMINANTS (BAREISS)
+//////////////////////////////////////////
+// LU needs division, so it is no use for integers, and cofactor expansion is
+// O(n!) with partial sums that overflow long before the determinant does.
+// Bareiss' fraction-free elimination does
+//   a[i][j] = (a[i][j] * a[k][k] - a[i][k] * a[k][j]) / a[k-1][k-1]
+// at step k. The division is always exact, every intermediate a[i][j] is the
+// determinant of a (k+1) x (k+1) submatrix (so it can't grow much larger than
+// the answer), and the last pivot is the determinant: O(n^3) and exact.
+//
+// The elimination runs in a wider accumulator type than T, because the
+// products before the division are about the square of a minor. __int128 is
+// used where the compiler has it.
+
+#if defined(__SIZEOF_INT128__)
+#  define MPCS51044_HAVE_INT128 1
+#else
+#  define MPCS51044_HAVE_INT128 0
+#endif
+
+namespace mpcs51044 {
+
+#if MPCS51044_HAVE_INT128
+__extension__ typedef __int128 BareissWide;
+#else
+typedef long long BareissWide;
+#endif
+
+// Element type of the elimination for integral T
+template<typename T>
+using BareissAccumulator = std::conditional_t<(sizeof(T) < sizeof(BareissWide)), BareissWide, T>;
+
+// det(a) for an n x n integral matrix; a is anything with operator()(int, int).
+// A 0 x 0 matrix has determinant 1 (the empty product)
+template<typename T, typename Acc = BareissAccumulator<T>, typename A>
+constexpr T bareissDeterminant(int n, A const &a)
+{
+	static_assert(std::is_integral_v<T>, "Bareiss elimination is for integral element types");
+	if (n == 0)
+		return T{ 1 };
+	vector<Acc> m(static_cast<size_t>(n) * n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			m[i * n + j] = static_cast<Acc>(a(i, j));
+	int sign = 1;
+	Acc previous = 1;
+	for (int k = 0; k < n - 1; k++) {
+		// Any nonzero pivot will do: there is no rounding error to control
+		if (m[k * n + k] == 0) {
+			int p = k + 1;
+			while (p < n && m[p * n + k] == 0)
+				p++;
+			if (p == n)
+				return T{};
+			std::swap_ranges(m.begin() + k * n, m.begin() + (k + 1) * n, m.begin() + p * n);
+			sign = -sign;
+		}
+		Acc const pivot = m[k * n + k];
+		for (int i = k + 1; i < n; i++) {
+			Acc const l = m[i * n + k];
+			for (int j = k + 1; j < n; j++)
+				m[i * n + j] = (m[i * n + j] * pivot - l * m[k * n + j]) / previous;
+		}
+		previous = pivot;
+	}
+	return static_cast<T>(sign * m[(n - 1) * n + (n - 1)]);
+}
+
+}
+#endif
@@ -0,0 +1,76 @@
+#include "ex_4_matrix_batch.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+using namespace mpcs51044_ps;
+using namespace std;
+
+// Same workload as ex_4_PSMatrix.cpp (100 million 3x3 determinants), over a
+// working set of distinct matrices: first as an array of Matrix objects,
+// then as one MatrixBatch
+int main()
+{
+	constexpr size_t batchSize = 4096;
+	constexpr size_t repetitions = 100'000'000 / batchSize;
+	Matrix<double, 3, 3> m = {
+			{ 1, 2, 3, },
+			{ 4, 5, 6, },
+			{ 7, 8, 9, }
+	};
+
+	vector<Matrix<double, 3, 3>> objects(batchSize, m);
+	MatrixBatch<double, 3, 3> batch(batchSize);
+	for (size_t b = 0; b < batchSize; b++) {
+		objects[b](1, 1) = static_cast<double>(b);
+		batch.set(b, objects[b]);
+	}
+	vector<double> dets(batchSize);
+
+	auto start = chrono::steady_clock::now();
+	static double total;
+	for (size_t r = 0; r < repetitions; r++) {
+		for (size_t b = 0; b < batchSize; b++) {
+			dets[b] = objects[b].determinant();
+		}
+		total += dets[r % batchSize];
+	}
+	cout << "one at a time: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+
+	start = chrono::steady_clock::now();
+	static double batchTotal;
+	for (size_t r = 0; r < repetitions; r++) {
+		batch.determinant(dets.data());
+		batchTotal += dets[r % batchSize];
+	}
+	cout << "batched:       " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	cout << (total == batchTotal ? "totals agree" : "totals differ") << endl;
+
+	// A * A^-1 should be the identity
+	MatrixBatch<double, 5, 5> five(3);
+	for (size_t b = 0; b < five.size(); b++) {
+		for (int i = 0; i < 5; i++) {
+			for (int j = 0; j < 5; j++) {
+				five(b, i, j) = (i == j ? 10.0 : 0.0) + static_cast<double>((i * 7 + j * 3 + b) % 5);
+			}
+		}
+	}
+	cout << (five * five.inverse()).get(2);
+	cout << five.determinant()[2] << " vs " << five.get(2).determinant() << endl;
+
+	// Make matrix 1 singular (two equal rows): its determinant is 0, it is
+	// flagged, and the other matrices still invert
+	for (int j = 0; j < 5; j++) {
+		five(1, 4, j) = five(1, 3, j);
+	}
+	vector<bool> singular;
+	MatrixBatch<double, 5, 5> inverses = five.inverse(singular);
+	cout << "determinant of matrix 1: " << five.determinant()[1]
+		<< (singular[1] && !singular[0] && !singular[2] ? ", flagged singular\n" : ", not flagged\n");
+	cout << (five * inverses).get(2);
+	try {
+		five.inverse();
+		cout << "inverse() of a batch with a singular matrix didn't throw" << endl;
+	} catch (domain_error const &e) {
+		cout << "inverse() threw: " << e.what() << endl;
+	}
+}
@@ -0,0 +1,328 @@
+#ifndef MATRIX_BATCH_H
+#  define MATRIX_BATCH_H
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "ex_4_PSMatrix.h"
+#include "ex_4_matrix_storage.h"
+
+using std::ptrdiff_t;
+using std::size_t;
+using std::vector;
+
+//////////////////////////////////////////
+// MATRIXBATCH: MANY SMALL MATRICES IN STRUCT-OF-ARRAYS FORM
+//////////////////////////////////////////
+// Calling determinant() on a million 3x3 matrices one at a time does a
+// handful of flops per call on data that is scattered across 9 * 8 byte
+// objects; nothing is left for the vector units to do.
+//
+// A MatrixBatch stores element (x, y) of every matrix contiguously (a
+// "plane"), so an operation on the whole batch is the scalar formula with
+// every element replaced by a plane, and the innermost loop runs across
+// matrices:
+//
+//     for each b: det[b] = a00[b] * (a11[b] * a22[b] - ...) ...
+//
+// which vectorizes with no shuffles. The loops run through forEachLane() from
+// ex_4_matrix_simd.h, so they use the widest vectors the CPU has. Planes are
+// cache line aligned and padded.
+//
+// Sizes above 3x3 use Gaussian elimination in chunks of matrices: pivots are
+// chosen per matrix, but the O(n^3) elimination updates still run across the
+// chunk. A matrix with no nonzero pivot left in some column is singular; its
+// lane stops eliminating (so it can't spread NaNs) and its determinant is 0.
+
+namespace mpcs51044_ps {
+
+template<typename T, int rows, int cols = rows>
+class MatrixBatch {
+public:
+	explicit MatrixBatch(size_t count)
+		: count(count),
+		  stride((count + lanesPerLine - 1) / lanesPerLine * lanesPerLine),
+		  elements(mpcs51044::allocateAligned<T>(stride * rows * cols)) {}
+
+	MatrixBatch(MatrixBatch const &other) : MatrixBatch(other.count) {
+		std::copy(other.elements.get(), other.elements.get() + stride * rows * cols, elements.get());
+	}
+	MatrixBatch &operator=(MatrixBatch const &other) {
+		if (this != &other)
+			*this = MatrixBatch(other);
+		return *this;
+	}
+	MatrixBatch(MatrixBatch &&) noexcept = default;
+	MatrixBatch &operator=(MatrixBatch &&) noexcept = default;
+
+	size_t size() const {
+		return count;
+	}
+
+	// Element (x, y) of matrix b
+	T &operator()(size_t b, int x, int y) {
+		return plane(x, y)[b];
+	}
+	T operator()(size_t b, int x, int y) const {
+		return plane(x, y)[b];
+	}
+
+	// Element (x, y) of every matrix, contiguous
+	T *plane(int x, int y) {
+		return elements.get() + (x * cols + y) * stride;
+	}
+	T const *plane(int x, int y) const {
+		return elements.get() + (x * cols + y) * stride;
+	}
+
+	Matrix<T, rows, cols> get(size_t b) const {
+		Matrix<T, rows, cols> result;
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < cols; j++)
+				result(i, j) = (*this)(b, i, j);
+		return result;
+	}
+	void set(size_t b, Matrix<T, rows, cols> const &m) {
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < cols; j++)
+				(*this)(b, i, j) = m(i, j);
+	}
+
+	// Determinants of every matrix in the batch
+	vector<T> determinant() const {
+		vector<T> result(count);
+		determinant(result.data());
+		return result;
+	}
+
+	// Same, into a caller-provided array of size() elements
+	void determinant(T *out) const {
+		static_assert(rows == cols, "Sorry, only square matrices have determinants");
+		auto p = [this](int x, int y) { return plane(x, y); };
+		if constexpr (rows == 1) {
+			std::copy(p(0, 0), p(0, 0) + count, out);
+		} else if constexpr (rows == 2) {
+			mpcs51044::forEachLane<T>(count, [&](auto lane, size_t i) {
+				using V = typename decltype(lane)::type;
+				auto x = [i, &p](int r, int c) -> V const & { return mpcs51044::at<V>(p(r, c) + i); };
+				mpcs51044::at<V>(out + i) = x(0, 0) * x(1, 1) - x(1, 0) * x(0, 1);
+			});
+		} else if constexpr (rows == 3) {
+			mpcs51044::forEachLane<T>(count, [&](auto lane, size_t i) {
+				using V = typename decltype(lane)::type;
+				auto x = [i, &p](int r, int c) -> V const & { return mpcs51044::at<V>(p(r, c) + i); };
+				mpcs51044::at<V>(out + i) = x(0, 0) * (x(1, 1) * x(2, 2) - x(1, 2) * x(2, 1))
+					- x(0, 1) * (x(1, 0) * x(2, 2) - x(1, 2) * x(2, 0))
+					+ x(0, 2) * (x(1, 0) * x(2, 1) - x(1, 1) * x(2, 0));
+			});
+		} else {
+			static_assert(std::is_floating_point_v<T>, "Batched elimination needs a floating point element type");
+			vector<T> work(static_cast<size_t>(rows) * cols * chunk);
+			for (size_t b0 = 0; b0 < count; b0 += chunk) {
+				size_t const lanes = std::min(chunk, count - b0);
+				load(work.data(), b0, lanes);
+				eliminate(work.data(), nullptr, 0, lanes, out + b0);
+			}
+		}
+	}
+
+	// Inverse of every matrix. Throws std::domain_error if any of them is
+	// singular; the overload below flags those matrices instead
+	MatrixBatch inverse() const {
+		vector<bool> singular;
+		MatrixBatch result = inverse(singular);
+		if (std::find(singular.begin(), singular.end(), true) != singular.end())
+			throw std::domain_error("Can't invert a singular matrix");
+		return result;
+	}
+
+	// Inverse of every matrix, setting singular[b] if matrix b is singular
+	// (its determinant is 0). The inverse of a singular matrix is all NaNs
+	MatrixBatch inverse(vector<bool> &singular) const {
+		static_assert(rows == cols, "Only square matrices have inverses");
+		static_assert(std::is_floating_point_v<T>, "Batched inverse needs a floating point element type");
+		MatrixBatch result(count);
+		singular.assign(count, false);
+		auto p = [this](int x, int y) { return plane(x, y); };
+		auto q = [&result](int x, int y) { return result.plane(x, y); };
+		if constexpr (rows <= 3) {
+			// The closed forms divide by the determinant, so look for zeros first
+			vector<T> det(count);
+			determinant(det.data());
+			for (size_t b = 0; b < count; b++)
+				singular[b] = det[b] == T{};
+			mpcs51044::forEachLane<T>(count, [&](auto lane, size_t i) {
+				using V = typename decltype(lane)::type;
+				auto x = [i, &p](int r, int c) -> V const & { return mpcs51044::at<V>(p(r, c) + i); };
+				auto y = [i, &q](int r, int c) -> V & { return mpcs51044::at<V>(q(r, c) + i); };
+				if constexpr (rows == 1) {
+					y(0, 0) = 1 / x(0, 0);
+				} else if constexpr (rows == 2) {
+					V const s = 1 / (x(0, 0) * x(1, 1) - x(1, 0) * x(0, 1));
+					y(0, 0) = x(1, 1) * s;
+					y(0, 1) = -x(0, 1) * s;
+					y(1, 0) = -x(1, 0) * s;
+					y(1, 1) = x(0, 0) * s;
+				} else {
+					// Adjugate (transposed cofactors) over the determinant
+					V const c00 = x(1, 1) * x(2, 2) - x(1, 2) * x(2, 1);
+					V const c01 = x(1, 2) * x(2, 0) - x(1, 0) * x(2, 2);
+					V const c02 = x(1, 0) * x(2, 1) - x(1, 1) * x(2, 0);
+					V const s = 1 / (x(0, 0) * c00 + x(0, 1) * c01 + x(0, 2) * c02);
+					y(0, 0) = c00 * s;
+					y(1, 0) = c01 * s;
+					y(2, 0) = c02 * s;
+					y(0, 1) = (x(0, 2) * x(2, 1) - x(0, 1) * x(2, 2)) * s;
+					y(1, 1) = (x(0, 0) * x(2, 2) - x(0, 2) * x(2, 0)) * s;
+					y(2, 1) = (x(0, 1) * x(2, 0) - x(0, 0) * x(2, 1)) * s;
+					y(0, 2) = (x(0, 1) * x(1, 2) - x(0, 2) * x(1, 1)) * s;
+					y(1, 2) = (x(0, 2) * x(1, 0) - x(0, 0) * x(1, 2)) * s;
+					y(2, 2) = (x(0, 0) * x(1, 1) - x(0, 1) * x(1, 0)) * s;
+				}
+			});
+		} else {
+			// Gauss-Jordan on [A | I] for each chunk
+			vector<T> work(static_cast<size_t>(rows) * cols * chunk);
+			vector<T> inv(static_cast<size_t>(rows) * cols * chunk);
+			vector<T> det(chunk);
+			for (size_t b0 = 0; b0 < count; b0 += chunk) {
+				size_t const lanes = std::min(chunk, count - b0);
+				load(work.data(), b0, lanes);
+				std::fill(inv.begin(), inv.end(), T{});
+				for (int i = 0; i < rows; i++)
+					std::fill_n(inv.begin() + (i * cols + i) * chunk, lanes, T{ 1 });
+				eliminate(work.data(), inv.data(), cols, lanes, det.data());
+				for (int i = 0; i < rows; i++)
+					for (int j = 0; j < cols; j++)
+						std::copy_n(inv.begin() + (i * cols + j) * chunk, lanes, result.plane(i, j) + b0);
+				for (size_t m = 0; m < lanes; m++)
+					singular[b0 + m] = det[m] == T{};
+			}
+		}
+		for (size_t b = 0; b < count; b++) {
+			if (singular[b]) {
+				for (int i = 0; i < rows; i++)
+					for (int j = 0; j < cols; j++)
+						result(b, i, j) = std::numeric_limits<T>::quiet_NaN();
+			}
+		}
+		return result;
+	}
+
+	// Matrix b of the result is l[b] * r[b]. Throws std::invalid_argument
+	// unless the batches are the same size
+	template<int c>
+	friend MatrixBatch<T, rows, c>
+	operator*(MatrixBatch const &l, MatrixBatch<T, cols, c> const &r) {
+		if (l.size() != r.size())
+			throw std::invalid_argument("Matrix batch sizes must match");
+		size_t const n = l.size();
+		MatrixBatch<T, rows, c> result(n);
+		for (int i = 0; i < rows; i++) {
+			for (int j = 0; j < c; j++) {
+				T *out = result.plane(i, j);
+				for (int k = 0; k < cols; k++) {
+					T const *a = l.plane(i, k);
+					T const *b = r.plane(k, j);
+					mpcs51044::forEachLane<T>(n, [=](auto lane, size_t m) {
+						using V = typename decltype(lane)::type;
+						mpcs51044::at<V>(out + m) += mpcs51044::at<V>(a + m) * mpcs51044::at<V>(b + m);
+					});
+				}
+			}
+		}
+		return result;
+	}
+
+private:
+	static constexpr size_t lanesPerLine = mpcs51044::cacheLineSize / sizeof(T) ? mpcs51044::cacheLineSize / sizeof(T) : 1;
+	// Matrices per elimination chunk: the working set of rows * cols planes of
+	// this many lanes stays in L1/L2 for small rows
+	static constexpr size_t chunk = 64;
+
+	// Copy matrices [b0, b0 + lanes) into a chunk-major scratch buffer
+	void load(T *work, size_t b0, size_t lanes) const {
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < cols; j++)
+				std::copy_n(plane(i, j) + b0, lanes, work + (i * cols + j) * chunk);
+	}
+
+	// Gaussian elimination with partial pivoting on `lanes` matrices at once.
+	// Without aug, eliminates below the diagonal and writes determinants to
+	// det. With aug (an augCols-wide right-hand side per matrix), runs
+	// Gauss-Jordan so that aug ends up holding A^-1 * aug. Singular matrices
+	// get a determinant of exactly 0, and whatever is left in their aug is
+	// meaningless.
+	void eliminate(T *a, T *aug, int augCols, size_t lanes, T *det) const {
+		auto at = [a](int i, int j) { return a + (i * cols + j) * chunk; };
+		auto augAt = [aug, augCols](int i, int j) { return aug + (i * augCols + j) * chunk; };
+		std::fill_n(det, lanes, T{ 1 });
+		for (int k = 0; k < rows; k++) {
+			// Per-matrix pivot search and row swap; O(n^2) of the O(n^3) work
+			for (size_t m = 0; m < lanes; m++) {
+				int p = k;
+				T best = std::abs(at(k, k)[m]);
+				for (int i = k + 1; i < rows; i++) {
+					if (std::abs(at(i, k)[m]) > best) {
+						best = std::abs(at(i, k)[m]);
+						p = i;
+					}
+				}
+				if (p != k) {
+					for (int j = 0; j < cols; j++)
+						std::swap(at(k, j)[m], at(p, j)[m]);
+					for (int j = 0; j < augCols; j++)
+						std::swap(augAt(k, j)[m], augAt(p, j)[m]);
+					det[m] = -det[m];
+				}
+			}
+			T *pivot = at(k, k);
+			for (size_t m = 0; m < lanes; m++)
+				det[m] *= pivot[m];
+			// Elimination, vectorized across matrices
+			// A zero pivot means the column is zero from k down: the matrix is
+			// singular (det[m] just became 0), and a zero scale leaves its
+			// rows alone instead of filling them with 0 * inf
+			T scale[chunk];
+			for (size_t m = 0; m < lanes; m++)
+				scale[m] = pivot[m] != T{} ? 1 / pivot[m] : T{};
+			for (int i = aug ? 0 : k + 1; i < rows; i++) {
+				if (i == k)
+					continue;
+				T factor[chunk];
+				T const *aik = at(i, k);
+				for (size_t m = 0; m < lanes; m++)
+					factor[m] = aik[m] * scale[m];
+				auto update = [&factor, lanes](T *dst, T const *src) {
+					mpcs51044::forEachLane<T>(lanes, [&](auto lane, size_t m) {
+						using V = typename decltype(lane)::type;
+						mpcs51044::at<V>(dst + m) -= mpcs51044::at<V>(factor + m) * mpcs51044::at<V>(src + m);
+					});
+				};
+				for (int j = k; j < cols; j++)
+					update(at(i, j), at(k, j));
+				for (int j = 0; j < augCols; j++)
+					update(augAt(i, j), augAt(k, j));
+			}
+		}
+		// Gauss-Jordan leaves A diagonal; divide it out of the right-hand side
+		for (int i = 0; aug && i < rows; i++) {
+			T const *aii = at(i, i);
+			for (int j = 0; j < augCols; j++) {
+				T *bij = augAt(i, j);
+				for (size_t m = 0; m < lanes; m++)
+					bij[m] /= aii[m];
+			}
+		}
+	}
+
+	size_t count;
+	size_t stride;
+	mpcs51044::AlignedArray<T> elements;
+};
+
+}
+#endif
@@ -0,0 +1,214 @@
+#include "ex_4_matrix.h"
+#include "ex_4_PSMatrix.h"
+#include "ex_4_overload_matrix.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+//////////////////////////////////////////
+// MATRIX BENCHMARKS
+//////////////////////////////////////////
+// ex_4_matrix_benchmark [max_size [min_seconds]]
+//
+// Times multiply, determinant, minor, add and print for each of the three
+// Matrix implementations at sizes 2, 4, 8, ..., 2048 (up to max_size), and
+// writes the results to stdout as JSON, one record per
+// (implementation, operation, size):
+//   ns_per_op     wall time per call, averaged over at least min_seconds
+//                 (default 0.2) of repeated calls after one warm-up call
+//   gflops        floating point operations per second: 2n^3 for multiply,
+//                 2n^3/3 for determinant (LU), n^2 for add, 0 otherwise
+//   bytes_per_op  the data the operation nominally reads and writes
+//                 (operands and dense result, or the text printed), the same
+//                 for every implementation so the rows can be compared
+// Progress goes to stderr, so redirect stdout to a file and diff it (or
+// feed it to a dashboard) between commits to spot regressions.
+//
+// Note that mpcs51044_ps::Matrix::minor() returns a zero-copy view, while
+// the other two copy the minor; the numbers show that difference.
+
+// Keep the compiler from discarding a result it can see is never used
+template<typename T>
+inline void doNotOptimize(T const &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "g"(&value) : "memory");
+#else
+	// No inline asm (MSVC): publishing the address through a volatile has
+	// the same effect
+	static void const *volatile sink;
+	sink = &value;
+#endif
+}
+
+// Make *dst the result of f() without a matrix-sized temporary. The returned
+// prvalue initializes *dst directly, and the functions it comes from return
+// a named local, which compilers construct straight into the return slot,
+// so even a 2048 x 2048 result never passes through the stack
+template<typename M, typename F>
+void constructResult(M &dst, F f)
+{
+	static_assert(std::is_trivially_destructible_v<M>);
+	::new (static_cast<void *>(&dst)) M(f());
+}
+
+struct Result {
+	string implementation;
+	string operation;
+	int size;
+	long iterations;
+	double nsPerOp;
+	double flops;
+	double bytes;
+};
+
+static double minSeconds = 0.2;
+static vector<Result> results;
+
+template<typename F>
+void measure(char const *implementation, char const *operation, int n, double flops, double bytes, F f)
+{
+	f();
+	long iterations = 0;
+	double elapsed = 0;
+	auto start = chrono::steady_clock::now();
+	// Time batches of growing size so the clock isn't read around every
+	// call of a 2x2 operation
+	for (long batch = 1; elapsed < minSeconds; batch *= 2) {
+		for (long i = 0; i < batch; i++)
+			f();
+		iterations += batch;
+		elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	results.push_back({ implementation, operation, n, iterations, elapsed * 1e9 / iterations, flops, bytes });
+	cerr << implementation << ' ' << operation << ' ' << n << ": " << results.back().nsPerOp << " ns\n";
+}
+
+double element(int i, int j, int n)
+{
+	return (i == j) * n + 1.0 / (i + j + 1);
+}
+
+template<int n, typename M>
+void fill(M &m)
+{
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			m(i, j) = element(i, j, n);
+}
+
+template<typename M>
+void benchmarkPrint(char const *implementation, int n, M const &a)
+{
+	ostringstream os;
+	measure(implementation, "print", n, 0, 0, [&] {
+		os.str("");
+		os << a;
+	});
+	results.back().bytes = static_cast<double>(os.str().size());
+}
+
+template<int n>
+void benchmarkSize()
+{
+	double const bytes = sizeof(double) * static_cast<double>(n) * n;
+	double const multiplyFlops = 2.0 * n * n * n;
+	double const luFlops = 2.0 * n * n * n / 3;
+	double const addFlops = static_cast<double>(n) * n;
+	double const minorBytes = bytes + sizeof(double) * static_cast<double>(n - 1) * (n - 1);
+
+	// Big fixed-size matrices are too large for the stack, so they all
+	// live on the heap, results included (see constructResult)
+	{
+		using M = mpcs51044_norm::Matrix<n, n>;
+		auto a = make_unique<M>(), b = make_unique<M>(), c = make_unique<M>();
+		auto m = make_unique<mpcs51044_norm::Matrix<n - 1, n - 1>>();
+		fill<n>(*a);
+		fill<n>(*b);
+		measure("norm", "multiply", n, multiplyFlops, 3 * bytes, [&] { *c = *a * *b; doNotOptimize(*c); });
+		measure("norm", "determinant", n, luFlops, bytes, [&] { doNotOptimize(a->determinant()); });
+		measure("norm", "minor", n, 0, minorBytes, [&] { constructResult(*m, [&] { return a->minor(0, 0); }); doNotOptimize(*m); });
+		measure("norm", "add", n, addFlops, 3 * bytes, [&] { *c = *a + *b; doNotOptimize(*c); });
+		benchmarkPrint("norm", n, *a);
+	}
+	{
+		using M = mpcs51044_ps::Matrix<double, n>;
+		auto a = make_unique<M>(), b = make_unique<M>(), c = make_unique<M>();
+		fill<n>(*a);
+		fill<n>(*b);
+		measure("ps", "multiply", n, multiplyFlops, 3 * bytes, [&] { *c = *a * *b; doNotOptimize(*c); });
+		measure("ps", "determinant", n, luFlops, bytes, [&] { doNotOptimize(a->determinant()); });
+		measure("ps", "minor", n, 0, minorBytes, [&] { doNotOptimize(a->minor(0, 0)); });
+		measure("ps", "add", n, addFlops, 3 * bytes, [&] { *c = *a + *b; doNotOptimize(*c); });
+		benchmarkPrint("ps", n, *a);
+	}
+	{
+		using M = mpcs51044_overload::Matrix<double, n>;
+		auto a = make_unique<M>(), b = make_unique<M>(), c = make_unique<M>();
+		auto m = make_unique<mpcs51044_overload::Matrix<double, n - 1>>();
+		fill<n>(*a);
+		fill<n>(*b);
+		measure("overload", "multiply", n, multiplyFlops, 3 * bytes, [&] { constructResult(*c, [&] { return *a * *b; }); doNotOptimize(*c); });
+		measure("overload", "determinant", n, luFlops, bytes, [&] { doNotOptimize(a->determinant()); });
+		measure("overload", "minor", n, 0, minorBytes, [&] { constructResult(*m, [&] { return a->minor(0, 0); }); doNotOptimize(*m); });
+		measure("overload", "add", n, addFlops, 3 * bytes, [&] { constructResult(*c, [&] { return *a + *b; }); doNotOptimize(*c); });
+		benchmarkPrint("overload", n, *a);
+	}
+}
+
+template<int... sizes>
+void benchmarkSizes(int maxSize)
+{
+	((sizes <= maxSize ? benchmarkSize<sizes>() : void()), ...);
+}
+
+string compilerVersion()
+{
+#if defined(__VERSION__)
+	return __VERSION__;
+#elif defined(_MSC_FULL_VER)
+	return "MSVC " + to_string(_MSC_FULL_VER);
+#else
+	return "unknown";
+#endif
+}
+
+void writeJson(ostream &os)
+{
+	os << "{\n  \"compiler\": \"" << compilerVersion() << "\",\n  \"min_seconds\": " << minSeconds
+		<< ",\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		Result const &r = results[i];
+		double const seconds = r.nsPerOp * 1e-9;
+		os << "    { \"implementation\": \"" << r.implementation << "\", \"operation\": \"" << r.operation
+			<< "\", \"size\": " << r.size << ", \"iterations\": " << r.iterations
+			<< ", \"ns_per_op\": " << r.nsPerOp << ", \"gflops\": " << r.flops / seconds * 1e-9
+			<< ", \"bytes_per_op\": " << static_cast<long long>(r.bytes) << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	os << "  ]\n}\n";
+}
+
+int main(int argc, char **argv)
+{
+	int const maxSize = argc > 1 ? atoi(argv[1]) : 2048;
+	if (argc > 2)
+		minSeconds = atof(argv[2]);
+
+	// Every operand and result lives on the heap, so an ordinary thread's
+	// stack (1MB on Windows) is enough even for 2048 x 2048
+	std::thread([maxSize] {
+		benchmarkSizes<2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048>(maxSize);
+	}).join();
+
+	cout.precision(6);
+	writeJson(cout);
+}
@@ -0,0 +1,70 @@
+#include "ex_4_matrix_chain.h"
+#include <iostream>
+#include <chrono>
+#include <memory>
+using namespace mpcs51044_ps;
+using namespace std;
+
+// Fibonacci numbers are powers of this
+constexpr Matrix<long long, 2> fibonacci = {
+	{ 1, 1, },
+	{ 1, 0, }
+};
+static_assert(pow(fibonacci, 0)(0, 1) == 0);
+static_assert(pow(fibonacci, 10)(0, 1) == 55);
+static_assert(pow(fibonacci, 90)(0, 1) == 2880067194370816120LL);
+
+// The textbook example: (A*B)*C is ten times cheaper than A*(B*C)
+static_assert(chainCost<Matrix<double, 10, 100>, Matrix<double, 100, 5>, Matrix<double, 5, 50>> == 7500);
+static_assert(chainPlan<Matrix<double, 10, 100>, Matrix<double, 100, 5>, Matrix<double, 5, 50>>().split[0][2] == 1);
+
+constexpr Matrix<int, 2, 3> a = {
+	{ 1, 2, 3, },
+	{ 4, 5, 6, }
+};
+constexpr Matrix<int, 3, 1> b = { { 1, }, { 1, }, { 1, } };
+constexpr Matrix<int, 1, 2> c = { { 2, 3, } };
+static_assert(multiplyChain(a, b, c)(1, 1) == 45);
+
+template<typename F>
+double seconds(F f)
+{
+	auto start = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+	// A tall-skinny chain: left to right builds 1000 x 1000 intermediates,
+	// the planned order only ever a 1000 x 8 one
+	auto x = make_unique<Matrix<double, 1000, 8>>();
+	auto y = make_unique<Matrix<double, 8, 1000>>();
+	auto z = make_unique<Matrix<double, 1000, 8>>();
+	for (int i = 0; i < 1000; i++) {
+		for (int j = 0; j < 8; j++) {
+			(*x)(i, j) = (*z)(i, j) = 1.0 / (i + j + 1);
+			(*y)(j, i) = i - j;
+		}
+	}
+	using X = Matrix<double, 1000, 8>;
+	using Y = Matrix<double, 8, 1000>;
+	X leftToRight, planned;
+	cout << "x*y*x left to right: " << seconds([&] { leftToRight = (*x * *y) * *z; }) << " seconds\n";
+	cout << "multiplyChain:       " << seconds([&] { planned = multiplyChain(*x, *y, *z); }) << " seconds, "
+		<< chainCost<X, Y, X> << " multiply-adds\n";
+	cout << "(999, 7): " << leftToRight(999, 7) << " vs " << planned(999, 7) << '\n';
+
+	auto m = make_unique<Matrix<double, 256, 256>>();
+	for (int i = 0; i < 256; i++)
+		(*m)(i, (i + 1) % 256) = 1;
+	Matrix<double, 256, 256> repeated, squared;
+	cout << "1000 multiplies: " << seconds([&] {
+		repeated = *m;
+		for (int k = 1; k < 1000; k++)
+			repeated = repeated * *m;
+	}) << " seconds\n";
+	cout << "pow(m, 1000):    " << seconds([&] { squared = pow(*m, 1000); }) << " seconds\n";
+	// m shifts by one place, so m^1000 shifts by 1000 % 256
+	cout << "m^1000(0, 232): " << repeated(0, 232) << ' ' << squared(0, 232) << endl;
+}
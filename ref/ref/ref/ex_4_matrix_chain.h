@@ -0,0 +1,190 @@
+#ifndef MATRIX_CHAIN_H
+#  define MATRIX_CHAIN_H
+#include <array>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include "ex_4_PSMatrix.h"
+#include "ex_4_dynamic_matrix.h"
+#include "ex_4_matrix_gemm.h"
+
+using std::array;
+
+//////////////////////////////////////////
+// MATRIX POWERS AND PRODUCT CHAINS
+//////////////////////////////////////////
+// pow(m, k) computes m^k by repeated squaring: m^13 = m^8 * m^4 * m^1, so
+// O(log k) products instead of k - 1. The running power, the running square
+// and one scratch matrix are all it needs; every product is written into the
+// scratch matrix, which then trades places with its operand (for heap
+// storage that swaps two pointers), so the loop allocates nothing.
+//
+// A product of several matrices can be evaluated in any order, but the cost
+// depends a lot on the order: with A 10x100, B 100x5 and C 5x50, (A*B)*C
+// takes 7500 multiply-adds and A*(B*C) 75000. multiplyChain(a, b, c, ...)
+// finds the cheapest order with the usual O(N^3) dynamic program over the
+// dimensions. Since those are template arguments, the program runs at
+// compile time and multiplyChain compiles to just the products in the
+// chosen order. chainCost<Ms...> is the number of multiply-adds it does.
+
+namespace mpcs51044_ps {
+
+// m^k for k >= 0 (m^0 is the identity)
+template<typename T, int n, template<typename, int, int> class S>
+constexpr Matrix<T, n, n, S> pow(Matrix<T, n, n, S> const &m, unsigned long long k)
+{
+	Matrix<T, n, n, S> result;
+	Matrix<T, n, n, S> square;
+	Matrix<T, n, n, S> scratch;
+	// result * factor, computed in scratch and moved into result
+	auto multiplyBy = [&scratch](Matrix<T, n, n, S> &result, Matrix<T, n, n, S> const &factor) {
+		mpcs51044::multiplyInto<T, n, n, n>(
+			mpcs51044::rowMajor(result.storage(), result.ld),
+			mpcs51044::rowMajor(factor.storage(), factor.ld),
+			scratch.storage(), scratch.ld);
+		std::swap(result, scratch);
+	};
+	if (k == 0) {
+		for (int i = 0; i < n; i++)
+			result(i, i) = T{ 1 };
+		return result;
+	}
+	// Skip the multiplications by the identity: start from the lowest set bit
+	square = m;
+	while (!(k & 1)) {
+		multiplyBy(square, square);
+		k >>= 1;
+	}
+	result = square;
+	while (k >>= 1) {
+		multiplyBy(square, square);
+		if (k & 1)
+			multiplyBy(result, square);
+	}
+	return result;
+}
+
+// Same for a square DynamicMatrix
+template<typename T>
+DynamicMatrix<T> pow(DynamicMatrix<T> const &m, unsigned long long k)
+{
+	int const n = m.rows();
+	if (m.cols() != n)
+		throw std::invalid_argument("Only square matrices have powers");
+	DynamicMatrix<T> result(n, n);
+	DynamicMatrix<T> square(n, n);
+	DynamicMatrix<T> scratch(n, n);
+	auto multiplyBy = [&scratch, n](DynamicMatrix<T> &result, DynamicMatrix<T> const &factor) {
+		mpcs51044::multiplyInto<T>(n, n, n,
+			mpcs51044::rowMajor(result.storage(), result.ld()),
+			mpcs51044::rowMajor(factor.storage(), factor.ld()),
+			scratch.storage(), scratch.ld());
+		std::swap(result, scratch);
+	};
+	if (k == 0) {
+		for (int i = 0; i < n; i++)
+			result(i, i) = T{ 1 };
+		return result;
+	}
+	square = m;
+	while (!(k & 1)) {
+		multiplyBy(square, square);
+		k >>= 1;
+	}
+	result = square;
+	while (k >>= 1) {
+		multiplyBy(square, square);
+		if (k & 1)
+			multiplyBy(result, square);
+	}
+	return result;
+}
+
+// Cheapest order for multiplying N matrices with dimensions d[0] x d[1],
+// d[1] x d[2], ..., d[N-1] x d[N]. cost[i][j] is the fewest multiply-adds
+// for the product of matrices i..j, and split[i][j] the k at which that
+// product is best split into (i..k) * (k+1..j).
+template<int N>
+struct ChainPlan {
+	long long cost[N][N];
+	int split[N][N];
+};
+
+template<int N>
+constexpr ChainPlan<N> planChain(array<long long, N + 1> const &d)
+{
+	ChainPlan<N> plan{};
+	for (int length = 2; length <= N; length++) {
+		for (int i = 0; i + length - 1 < N; i++) {
+			int const j = i + length - 1;
+			plan.cost[i][j] = -1;
+			for (int k = i; k < j; k++) {
+				long long const cost = plan.cost[i][k] + plan.cost[k + 1][j] + d[i] * d[k + 1] * d[j + 1];
+				if (plan.cost[i][j] < 0 || cost < plan.cost[i][j]) {
+					plan.cost[i][j] = cost;
+					plan.split[i][j] = k;
+				}
+			}
+		}
+	}
+	return plan;
+}
+
+// Whether each matrix has as many columns as the next one has rows
+template<MatrixOperand... Ms>
+constexpr bool chainable()
+{
+	constexpr array<int, sizeof...(Ms)> rows = { Ms::nrows... };
+	constexpr array<int, sizeof...(Ms)> cols = { Ms::ncols... };
+	for (size_t i = 0; i + 1 < sizeof...(Ms); i++)
+		if (cols[i] != rows[i + 1])
+			return false;
+	return true;
+}
+
+// The plan for a chain of Matrix or MatrixView types
+template<MatrixOperand... Ms>
+constexpr ChainPlan<sizeof...(Ms)> chainPlan()
+{
+	constexpr int N = sizeof...(Ms);
+	constexpr array<int, N> rows = { Ms::nrows... };
+	constexpr array<int, N> cols = { Ms::ncols... };
+	array<long long, N + 1> d{};
+	for (int i = 0; i < N; i++)
+		d[i] = rows[i];
+	d[N] = cols[N - 1];
+	return planChain<N>(d);
+}
+
+template<MatrixOperand... Ms>
+inline constexpr long long chainCost = chainPlan<Ms...>().cost[0][sizeof...(Ms) - 1];
+
+// Product of operands i..j of the tuple ms in the order plan says
+template<int i, int j, auto plan, typename Tuple>
+constexpr decltype(auto) chainProduct(Tuple const &ms)
+{
+	if constexpr (i == j) {
+		return std::get<i>(ms);
+	} else {
+		constexpr int k = plan.split[i][j];
+		return chainProduct<i, k, plan>(ms) * chainProduct<k + 1, j, plan>(ms);
+	}
+}
+
+// m * ms... in the cheapest order. Named in camelCase like multiplyInto and
+// the other ex_4 matrix functions (the ex_5 containers are the snake_case ones)
+template<MatrixOperand M, MatrixOperand... Ms>
+constexpr auto multiplyChain(M const &m, Ms const &... ms)
+{
+	static_assert(chainable<M, Ms...>(), "Inner Matrix dimensions must match");
+	static_assert((std::is_same_v<typename M::value_type, typename Ms::value_type> && ...),
+		"Every Matrix in a chain needs the same element type");
+	if constexpr (sizeof...(Ms) == 0) {
+		return Matrix<typename M::value_type, M::nrows, M::ncols>(m);
+	} else {
+		return chainProduct<0, sizeof...(Ms), chainPlan<M, Ms...>()>(std::forward_as_tuple(m, ms...));
+	}
+}
+
+}
+#endif
@@ -0,0 +1,177 @@
+#ifndef MATRIX_CHOLESKY_H
+#  define MATRIX_CHOLESKY_H
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_lu.h"
+#include "ex_4_matrix_triangular.h"
+
+using std::ptrdiff_t;
+using std::vector;
+
+//////////////////////////////////////////
+// CHOLESKY DECOMPOSITION
+//////////////////////////////////////////
+// A symmetric positive definite matrix (covariances, normal equations,
+// stiffness matrices, ...) factors as A = L * L^T with L lower triangular.
+// That needs no pivoting, half the flops of LU and only the lower triangle
+// of A, and fails exactly when A isn't positive definite.
+//
+// Like luFactor() it is right-looking and blocked: a panel of NB columns is
+// factored directly, then the rest of the lower triangle is updated with
+// A22 -= L21 * L21^T, in strips so the GEMM kernel computes little more than
+// the lower triangle.
+
+namespace mpcs51044 {
+
+// Factor the lower triangle of the n x n row-major matrix at a in place into
+// L; the upper triangle is used as scratch. Returns false (leaving a partly
+// factored) if the matrix isn't positive definite.
+template<typename T, typename Gemm = SerialGemm>
+bool choleskyFactor(int n, T *a, ptrdiff_t lda, Gemm const &gemm = {})
+{
+	constexpr int NB = 32;
+	constexpr int strip = 4 * NB;
+	for (int k0 = 0; k0 < n; k0 += NB) {
+		int const kEnd = std::min(k0 + NB, n);
+
+		// (1) factor the panel a[k0:n, k0:kEnd)
+		for (int k = k0; k < kEnd; k++) {
+			T const d = a[k * lda + k] - dotProduct(k - k0, a + k * lda + k0, a + k * lda + k0);
+			if (!(d > T{}))
+				return false;
+			T const l = std::sqrt(d);
+			a[k * lda + k] = l;
+			for (int i = k + 1; i < n; i++)
+				a[i * lda + k] = (a[i * lda + k] - dotProduct(k - k0, a + i * lda + k0, a + k * lda + k0)) / l;
+		}
+		if (kEnd == n)
+			break;
+
+		// (2) A22 -= L21 * L21^T, a strip of rows at a time up to the diagonal
+		StridedOperand<T> const l21Transposed{ a + kEnd * lda + k0, 1, lda };
+		for (int i0 = kEnd; i0 < n; i0 += strip) {
+			int const i1 = std::min(i0 + strip, n);
+			gemm(i1 - i0, i1 - kEnd, kEnd - k0,
+				NegatedOperand<StridedOperand<T>>{ rowMajor<T>(a + i0 * lda + k0, lda) },
+				l21Transposed, a + i0 * lda + kEnd, lda);
+		}
+	}
+	return true;
+}
+
+// A reusable A = L * L^T factorization of a symmetric positive definite n x n
+// matrix, with the same interface as LUDecomposition. Only the lower triangle
+// of the source is read.
+template<typename T, int n = dynamicSize>
+class CholeskyDecomposition {
+	static_assert(std::is_floating_point_v<T>, "Cholesky decomposition needs a floating point element type");
+public:
+	CholeskyDecomposition(T const *src, ptrdiff_t ld) requires (n != dynamicSize) : dim(n) {
+		factorFrom(src, ld, SerialGemm{});
+	}
+
+	template<typename Gemm>
+	CholeskyDecomposition(T const *src, ptrdiff_t ld, Gemm const &gemm) requires (n != dynamicSize) : dim(n) {
+		factorFrom(src, ld, gemm);
+	}
+
+	CholeskyDecomposition(int size, T const *src, ptrdiff_t ld) requires (n == dynamicSize) : dim(size) {
+		factorFrom(src, ld, SerialGemm{});
+	}
+
+	template<typename Gemm>
+	CholeskyDecomposition(int size, T const *src, ptrdiff_t ld, Gemm const &gemm) requires (n == dynamicSize) : dim(size) {
+		factorFrom(src, ld, gemm);
+	}
+
+	int size() const {
+		return dim;
+	}
+
+	bool positiveDefinite() const {
+		return spd;
+	}
+
+	// det(A) = det(L)^2; 0 if A wasn't positive definite
+	T determinant() const {
+		if (!spd)
+			return T{};
+		T val = 1;
+		for (int i = 0; i < dim; i++)
+			val *= l[i * dim + i];
+		return val * val;
+	}
+
+	// L (zero above the diagonal)
+	T factor(int x, int y) const {
+		return y <= x ? l[x * dim + y] : T{};
+	}
+
+	// Solve A * x = b in O(n^2): b (size() elements) is overwritten with x.
+	// Throws std::domain_error if A isn't positive definite.
+	void solve(T *b) const {
+		checkSolvable();
+		triangularSolve(Triangle::Lower, false, dim, l.data(), dim, b);
+		triangularSolve(Triangle::LowerTransposed, false, dim, l.data(), dim, b);
+	}
+
+	vector<T> solve(vector<T> b) const {
+		if (static_cast<int>(b.size()) != dim)
+			throw std::invalid_argument("Matrix and vector sizes must match");
+		solve(b.data());
+		return b;
+	}
+
+	// Solve A * X = B for the nrhs columns of the row-major size() x nrhs B
+	// (leading dimension ldb) at once, overwriting B with X
+	void solveMany(int nrhs, T *b, ptrdiff_t ldb) const {
+		checkSolvable();
+		triangularSolve(Triangle::Lower, false, dim, l.data(), dim, nrhs, b, ldb);
+		triangularSolve(Triangle::LowerTransposed, false, dim, l.data(), dim, nrhs, b, ldb);
+	}
+
+	template<typename M>
+	M solveMany(M b) const {
+		if (rowsOf(b) != dim)
+			throw std::invalid_argument("Matrix sizes must match");
+		solveMany(colsOf(b), b.storage(), ldOf(b));
+		return b;
+	}
+
+	void inverse(T *out, ptrdiff_t ldo) const {
+		for (int i = 0; i < dim; i++)
+			for (int j = 0; j < dim; j++)
+				out[i * ldo + j] = i == j ? T{ 1 } : T{};
+		solveMany(dim, out, ldo);
+	}
+
+private:
+	template<typename Gemm>
+	void factorFrom(T const *src, ptrdiff_t ld, Gemm const &gemm) {
+		l.assign(static_cast<size_t>(dim) * dim, T{});
+		for (int i = 0; i < dim; i++)
+			std::copy(src + i * ld, src + i * ld + i + 1, l.begin() + i * dim);
+		spd = choleskyFactor(dim, l.data(), dim, gemm);
+		// Clear the scratch above the diagonal so factor() and the solves
+		// only ever see L
+		for (int i = 0; i < dim; i++)
+			std::fill(l.begin() + i * dim + i + 1, l.begin() + (i + 1) * dim, T{});
+	}
+
+	void checkSolvable() const {
+		if (!spd)
+			throw std::domain_error("Can't solve: the matrix isn't positive definite");
+	}
+
+	int dim;
+	vector<T> l;
+	bool spd = false;
+};
+
+}
+#endif
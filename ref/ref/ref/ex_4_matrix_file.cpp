@@ -0,0 +1,58 @@
+#include "ex_4_matrix_file.h"
+#include "ex_4_dynamic_matrix.h"
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+using namespace mpcs51044_ps;
+using namespace std;
+
+// ex_4_matrix_file [n [path]]: checkpoint an n x n matrix and map it back
+int main(int argc, char **argv)
+{
+	int const n = argc > 1 ? atoi(argv[1]) : 4096;
+	string const path = argc > 2 ? argv[2] : "ex_4_matrix_file.mat";
+
+	// Stream it out 64 rows at a time; the whole matrix is never in memory
+	auto start = chrono::steady_clock::now();
+	MatrixWriter<double> writer(path, n, n);
+	DynamicMatrix<double> rows(64, n);
+	for (int first = 0; first < n; first += rows.rows()) {
+		int const count = min(rows.rows(), n - first);
+		for (int i = 0; i < count; i++)
+			for (int j = 0; j < n; j++)
+				rows(i, j) = (first + i == j) + 1.0 / (first + i + j + 1);
+		writer.appendRows(rows.storage(), count, rows.ld());
+	}
+	writer.finish();
+	cout << "wrote " << n << "x" << n << ": " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+
+	start = chrono::steady_clock::now();
+	MappedMatrix<double> mapped = loadMatrix<double>(path);
+	cout << "mapped: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	mapped.adviseSequential();
+	double trace = 0;
+	for (int i = 0; i < mapped.rows(); i++)
+		trace += mapped(i, i);
+	cout << "trace: " << trace << '\n';
+
+	// Fixed-size matrices go through MatrixView without a copy
+	Matrix<double, 3> m = {
+		{ 1, 2, 3, },
+		{ 4, 5, 6, },
+		{ 7, 8, 10, }
+	};
+	saveMatrix(path, m);
+	auto small = loadMatrix<double>(path);
+	MatrixView<double, 3, 3> view = small.view<3, 3>();
+	cout << view << view.transpose() << "determinant: " << view.determinant() << endl;
+
+	try {
+		loadMatrix<float>(path);
+	} catch (exception &e) {
+		cout << e.what() << endl;
+	}
+	remove(path.c_str());
+}
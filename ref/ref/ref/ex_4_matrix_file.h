@@ -0,0 +1,411 @@
+#ifndef MATRIX_FILE_H
+#  define MATRIX_FILE_H
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+#include "ex_4_PSMatrix.h"
+#include "ex_4_matrix_format.h"
+
+using std::ptrdiff_t;
+using std::size_t;
+using std::string;
+
+//////////////////////////////////////////
+// MATRIX FILES
+//////////////////////////////////////////
+// A checkpoint file is a 64 byte MatrixFileHeader followed by the elements:
+//
+//   magic        "MPCSMAT\0"
+//   version      MatrixFileHeader::currentVersion (1)
+//   dtype        element type (MatrixDType) and its size in bytes
+//   byteOrder    0x01020304 as written, so a file from a machine with the
+//                other byte order is rejected instead of read as garbage
+//   layout       RowMajor (element (i, j) at i * ld + j) or ColMajor (j * ld + i)
+//   rows, cols, ld
+//   dataOffset   where the elements start, a multiple of alignment
+//
+// loadMatrix() mmaps the file read-only and hands back a MappedMatrix that
+// reads the elements straight out of the page cache: nothing is copied and
+// only the pages actually touched are read from disk. view<rows, cols>() turns
+// it into the usual MatrixView (a column-major file just becomes a view with
+// the strides swapped).
+//
+// MatrixWriter streams a matrix out a block of rows at a time, so one larger
+// than memory can be produced piece by piece; saveMatrix() writes a whole one.
+//
+// Problems with the file itself (missing, truncated, wrong element type)
+// throw std::runtime_error, and failing system calls std::system_error.
+//
+// FileMapping hides the one platform-specific part: mmap on POSIX systems,
+// CreateFileMapping/MapViewOfFile on Windows (MSVC and MinGW).
+
+namespace mpcs51044_ps {
+
+enum class MatrixDType : std::uint32_t { Int32 = 1, Int64 = 2, Float32 = 3, Float64 = 4 };
+enum class MatrixLayout : std::uint32_t { RowMajor = 0, ColMajor = 1 };
+
+template<typename T> struct MatrixDTypeOf;
+// By size rather than as int32_t/int64_t, so both long and long long are
+// Int64 on LP64 (where int64_t is long) and on LLP64 (where it's long long)
+template<typename T> requires std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) == 4)
+struct MatrixDTypeOf<T> { static constexpr MatrixDType value = MatrixDType::Int32; };
+template<typename T> requires std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) == 8)
+struct MatrixDTypeOf<T> { static constexpr MatrixDType value = MatrixDType::Int64; };
+template<> struct MatrixDTypeOf<float> { static constexpr MatrixDType value = MatrixDType::Float32; };
+template<> struct MatrixDTypeOf<double> { static constexpr MatrixDType value = MatrixDType::Float64; };
+
+struct MatrixFileHeader {
+	static constexpr char expectedMagic[8] = { 'M', 'P', 'C', 'S', 'M', 'A', 'T', '\0' };
+	static constexpr std::uint32_t currentVersion = 1;
+	static constexpr std::uint32_t nativeByteOrder = 0x01020304;
+	// Elements start on a cache line, like AlignedArray's
+	static constexpr std::uint32_t defaultAlignment = 64;
+
+	char magic[8];
+	std::uint32_t version;
+	MatrixDType dtype;
+	std::uint32_t elementSize;
+	std::uint32_t byteOrder;
+	MatrixLayout layout;
+	std::uint32_t alignment;
+	std::uint64_t rows;
+	std::uint64_t cols;
+	std::uint64_t ld;
+	std::uint64_t dataOffset;
+};
+static_assert(sizeof(MatrixFileHeader) == 64 && std::is_trivially_copyable_v<MatrixFileHeader>);
+
+// The whole of a file, mapped read-only. An empty file maps to nothing
+// (data() is null and size() 0)
+class FileMapping {
+public:
+	explicit FileMapping(string const &path) {
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "Can't open " + path);
+		LARGE_INTEGER fileBytes;
+		if (!GetFileSizeEx(file, &fileBytes)) {
+			DWORD error = GetLastError();
+			CloseHandle(file);
+			throw std::system_error(static_cast<int>(error), std::system_category(), "Can't stat " + path);
+		}
+		bytes = static_cast<size_t>(fileBytes.QuadPart);
+		DWORD error = 0;
+		if (bytes) {
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping) {
+				base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				error = GetLastError();
+				// The view keeps the mapping (and the file) alive by itself
+				CloseHandle(mapping);
+			} else {
+				error = GetLastError();
+			}
+		}
+		CloseHandle(file);
+		if (bytes && !base)
+			throw std::system_error(static_cast<int>(error), std::system_category(), "Can't map " + path);
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw std::system_error(errno, std::generic_category(), "Can't open " + path);
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			int error = errno;
+			close(fd);
+			throw std::system_error(error, std::generic_category(), "Can't stat " + path);
+		}
+		bytes = static_cast<size_t>(st.st_size);
+		void *mapping = bytes ? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+		int error = errno;
+		// The mapping keeps the file alive by itself
+		close(fd);
+		if (bytes && mapping == MAP_FAILED)
+			throw std::system_error(error, std::generic_category(), "Can't map " + path);
+		if (bytes)
+			base = mapping;
+#endif
+	}
+	FileMapping(FileMapping &&other) noexcept
+		: base(std::exchange(other.base, nullptr)), bytes(std::exchange(other.bytes, 0)) {}
+	FileMapping &operator=(FileMapping &&other) noexcept {
+		std::swap(base, other.base);
+		std::swap(bytes, other.bytes);
+		return *this;
+	}
+	FileMapping(FileMapping const &) = delete;
+	FileMapping &operator=(FileMapping const &) = delete;
+	~FileMapping() {
+		if (!base)
+			return;
+#if defined(_WIN32)
+		UnmapViewOfFile(base);
+#else
+		munmap(base, bytes);
+#endif
+	}
+
+	void const *data() const {
+		return base;
+	}
+	size_t size() const {
+		return bytes;
+	}
+
+	// Hints for the kernel's read-ahead. Windows has no equivalent of
+	// MADV_SEQUENTIAL for a mapped view, so there they do nothing
+	void adviseSequential() const {
+#if !defined(_WIN32)
+		if (base)
+			madvise(base, bytes, MADV_SEQUENTIAL);
+#endif
+	}
+	void adviseWillNeed() const {
+#if !defined(_WIN32)
+		if (base)
+			madvise(base, bytes, MADV_WILLNEED);
+#endif
+	}
+
+private:
+	void *base = nullptr;
+	size_t bytes = 0;
+};
+
+// Read-only matrix backed by a mapping of a file written by MatrixWriter
+template<typename T>
+class MappedMatrix {
+public:
+	using value_type = T;
+
+	MappedMatrix(MappedMatrix &&) noexcept = default;
+	MappedMatrix &operator=(MappedMatrix &&) noexcept = default;
+	MappedMatrix(MappedMatrix const &) = delete;
+	MappedMatrix &operator=(MappedMatrix const &) = delete;
+
+	int rows() const {
+		return nr;
+	}
+	int cols() const {
+		return nc;
+	}
+	T operator()(int x, int y) const {
+		return elements[x * rs + y * cs];
+	}
+
+	// First element and the distance between rows and between columns
+	T const *origin() const {
+		return elements;
+	}
+	ptrdiff_t rowStride() const {
+		return rs;
+	}
+	ptrdiff_t colStride() const {
+		return cs;
+	}
+
+	// A view onto the mapped elements; like any view it must not outlive this
+	template<int rows, int cols>
+	MatrixView<T, rows, cols> view() const {
+		if (rows != nr || cols != nc)
+			throw std::invalid_argument("Matrix sizes must match");
+		return { elements, rs, cs };
+	}
+
+	// Tell the kernel how the elements are about to be read
+	void adviseSequential() const {
+		mapping.adviseSequential();
+	}
+	void adviseWillNeed() const {
+		mapping.adviseWillNeed();
+	}
+
+	inline friend
+		ostream &
+		operator<<
+		(ostream &os, const MappedMatrix &m) {
+		return printMatrix(os, m, m.rows(), m.cols());
+	}
+
+private:
+	template<typename U> friend MappedMatrix<U> loadMatrix(string const &path);
+	explicit MappedMatrix(FileMapping mapping) : mapping(std::move(mapping)) {}
+
+	FileMapping mapping;
+	T const *elements = nullptr;
+	int nr = 0;
+	int nc = 0;
+	ptrdiff_t rs = 0;
+	ptrdiff_t cs = 0;
+};
+
+template<typename T>
+MappedMatrix<T> loadMatrix(string const &path)
+{
+	MappedMatrix<T> result{ FileMapping(path) };
+	void const *mapping = result.mapping.data();
+	size_t const fileBytes = result.mapping.size();
+
+	MatrixFileHeader header;
+	if (fileBytes < sizeof header)
+		throw std::runtime_error(path + " is not a matrix file");
+	std::memcpy(&header, mapping, sizeof header);
+	if (std::memcmp(header.magic, MatrixFileHeader::expectedMagic, sizeof header.magic) != 0)
+		throw std::runtime_error(path + " is not a matrix file");
+	if (header.version == 0 || header.version > MatrixFileHeader::currentVersion)
+		throw std::runtime_error(path + " is from a newer version of the matrix file format");
+	if (header.byteOrder != MatrixFileHeader::nativeByteOrder)
+		throw std::runtime_error(path + " was written with a different byte order");
+	if (header.dtype != MatrixDTypeOf<T>::value || header.elementSize != sizeof(T))
+		throw std::runtime_error(path + " holds a different element type");
+	if (header.layout != MatrixLayout::RowMajor && header.layout != MatrixLayout::ColMajor)
+		throw std::runtime_error(path + " has an unknown layout");
+	bool const rowMajor = header.layout == MatrixLayout::RowMajor;
+	std::uint64_t const outer = rowMajor ? header.rows : header.cols;
+	std::uint64_t const inner = rowMajor ? header.cols : header.rows;
+	if (header.rows > INT32_MAX || header.cols > INT32_MAX || header.ld < inner
+		|| header.dataOffset < sizeof header || header.dataOffset % alignof(T) != 0)
+		throw std::runtime_error(path + " has a corrupt header");
+	std::uint64_t const available = (fileBytes - std::min<std::uint64_t>(fileBytes, header.dataOffset)) / sizeof(T);
+	if (outer && inner && (inner > available || (outer - 1) > (available - inner) / header.ld))
+		throw std::runtime_error(path + " is truncated");
+
+	result.elements = reinterpret_cast<T const *>(static_cast<char const *>(mapping) + header.dataOffset);
+	result.nr = static_cast<int>(header.rows);
+	result.nc = static_cast<int>(header.cols);
+	result.rs = rowMajor ? static_cast<ptrdiff_t>(header.ld) : 1;
+	result.cs = rowMajor ? 1 : static_cast<ptrdiff_t>(header.ld);
+	return result;
+}
+
+// Writes a rows x cols row-major matrix file, appendRows() at a time.
+// Only the block being appended has to be in memory.
+template<typename T>
+class MatrixWriter {
+public:
+	// Bad dimensions throw before the file is created (or truncated)
+	MatrixWriter(string const &path, int rows, int cols)
+		: path(path), nr(checkDimension(rows)), nc(checkDimension(cols)),
+		  out(path, std::ios::binary | std::ios::trunc) {
+		if (!out)
+			throw std::system_error(errno, std::generic_category(), "Can't create " + path);
+		MatrixFileHeader header{};
+		std::memcpy(header.magic, MatrixFileHeader::expectedMagic, sizeof header.magic);
+		header.version = MatrixFileHeader::currentVersion;
+		header.dtype = MatrixDTypeOf<T>::value;
+		header.elementSize = sizeof(T);
+		header.byteOrder = MatrixFileHeader::nativeByteOrder;
+		header.layout = MatrixLayout::RowMajor;
+		header.alignment = MatrixFileHeader::defaultAlignment;
+		header.rows = static_cast<std::uint64_t>(rows);
+		header.cols = static_cast<std::uint64_t>(cols);
+		header.ld = static_cast<std::uint64_t>(cols);
+		header.dataOffset = std::max<std::uint64_t>(sizeof header, header.alignment);
+		out.write(reinterpret_cast<char const *>(&header), sizeof header);
+		for (std::uint64_t i = sizeof header; i < header.dataOffset; i++)
+			out.put('\0');
+	}
+
+	MatrixWriter(MatrixWriter const &) = delete;
+	MatrixWriter &operator=(MatrixWriter const &) = delete;
+
+	// Destructors shouldn't throw, so call finish() to find out about errors
+	~MatrixWriter() {
+		if (out.is_open())
+			out.close();
+	}
+
+	// The next count rows, ldSrc elements apart starting at src
+	void appendRows(T const *src, int count, ptrdiff_t ldSrc) {
+		checkRoom(count);
+		if (ldSrc == nc) {
+			out.write(reinterpret_cast<char const *>(src), static_cast<std::streamsize>(count) * nc * sizeof(T));
+		} else {
+			for (int i = 0; i < count; i++)
+				out.write(reinterpret_cast<char const *>(src + i * ldSrc), static_cast<std::streamsize>(nc) * sizeof(T));
+		}
+		written += count;
+		checkStream();
+	}
+
+	// The next count rows, taken from the top of any matrix with operator()
+	template<typename M>
+	void appendRows(M const &m, int count) {
+		checkRoom(count);
+		mpcs51044::writeBinary(out, m, count, nc);
+		written += count;
+		checkStream();
+	}
+
+	int rowsWritten() const {
+		return written;
+	}
+
+	// Flush and close; throws unless every row was appended
+	void finish() {
+		if (written != nr)
+			throw std::runtime_error(path + ": only " + std::to_string(written) + " of "
+				+ std::to_string(nr) + " rows were written");
+		out.close();
+		if (!out)
+			throw std::system_error(errno, std::generic_category(), "Can't write " + path);
+	}
+
+private:
+	static int checkDimension(int n) {
+		if (n < 0)
+			throw std::invalid_argument("Matrix dimensions can't be negative");
+		return n;
+	}
+	void checkRoom(int count) const {
+		if (count < 0 || count > nr - written)
+			throw std::out_of_range("More rows than the matrix file was created with");
+	}
+	void checkStream() {
+		if (!out)
+			throw std::system_error(errno, std::generic_category(), "Can't write " + path);
+	}
+
+	string path;
+	int nr;
+	int nc;
+	std::ofstream out;
+	int written = 0;
+};
+
+// Write any matrix with rows(), cols() (or nrows, ncols) and operator()
+template<typename M>
+void saveMatrix(string const &path, M const &m, int rows = M::nrows, int cols = M::ncols)
+{
+	using T = std::remove_cvref_t<decltype(m(0, 0))>;
+	MatrixWriter<T> writer(path, rows, cols);
+	writer.appendRows(m, rows);
+	writer.finish();
+}
+
+}
+#endif
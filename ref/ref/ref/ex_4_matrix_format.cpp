@@ -0,0 +1,89 @@
+#include "ex_4_dynamic_matrix.h"
+#include "ex_4_matrix_format.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+#include <vector>
+using namespace mpcs51044_ps;
+using namespace std;
+
+// What operator<< used to do: measure every element through its own
+// ostringstream, then format each one again with setw
+template<typename M>
+void streamMatrix(ostream &os, M const &m)
+{
+	size_t width = 0;
+	for (int i = 0; i < m.rows(); i++) {
+		for (int j = 0; j < m.cols(); j++) {
+			ostringstream ostr;
+			ostr << m(i, j);
+			width = max(width, ostr.str().size());
+		}
+	}
+	os << "[ " << endl;
+	for (int i = 0; i < m.rows(); i++) {
+		for (int j = 0; j < m.cols(); j++)
+			os << setw(static_cast<streamsize>(width + 2)) << m(i, j);
+		os << endl;
+	}
+	os << "]" << endl;
+}
+
+template<typename F>
+double seconds(F f)
+{
+	auto start = chrono::steady_clock::now();
+	f();
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// ex_4_matrix_format [n]: time printing an n x n matrix each way
+int main(int argc, char **argv)
+{
+	int const n = argc > 1 ? atoi(argv[1]) : 1000;
+	DynamicMatrix<double> a(n, n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			a(i, j) = (i - j) / (1.0 + i + j);
+
+	ostringstream before, after, csv, binary;
+	cout << "setw per element: " << seconds([&] { streamMatrix(before, a); }) << " seconds\n";
+	cout << "to_chars:         " << seconds([&] { after << a; }) << " seconds\n";
+	cout << "same text: " << (before.str() == after.str() ? "yes" : "no") << '\n';
+	cout << "csv:              " << seconds([&] { mpcs51044::writeCsv(csv, a, n, n); }) << " seconds, "
+		<< csv.str().size() << " bytes\n";
+	cout << "binary:           " << seconds([&] { mpcs51044::writeBinary(binary, a, n, n); }) << " seconds, "
+		<< binary.str().size() << " bytes\n";
+
+	// Both dumps read back exactly
+	string const text = csv.str();
+	vector<double> values(static_cast<size_t>(n) * n);
+	char const *p = text.data();
+	for (auto &v : values)
+		p = from_chars(p, text.data() + text.size(), v).ptr + 1;
+	string const bytes = binary.str();
+	bool csvExact = true, binaryExact = true;
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			double b;
+			memcpy(&b, bytes.data() + (i * n + j) * sizeof(double), sizeof(double));
+			csvExact = csvExact && values[i * n + j] == a(i, j);
+			binaryExact = binaryExact && b == a(i, j);
+		}
+	}
+	cout << "csv round trip exact: " << (csvExact ? "yes" : "no")
+		<< ", binary round trip exact: " << (binaryExact ? "yes" : "no") << '\n';
+
+	DynamicMatrix<int> small = { { 1, -20 }, { 300, 4 } };
+	cout << small;
+	mpcs51044::writeCsv(cout, small, 2, 2);
+	// Flags to_chars can't follow go through a stream instead
+	cout << showpos << small << noshowpos;
+	cout << hex << showbase << small << dec << noshowbase;
+	cout << hexfloat;
+	cout << DynamicMatrix<double>{ { 0.5, -3 } } << endl;
+}
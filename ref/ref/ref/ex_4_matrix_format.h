@@ -0,0 +1,215 @@
+#ifndef MATRIX_FORMAT_H
+#  define MATRIX_FORMAT_H
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+using std::ostream;
+using std::size_t;
+using std::string;
+using std::vector;
+
+//////////////////////////////////////////
+// MATRIX OUTPUT
+//////////////////////////////////////////
+// operator<< used to make an ostringstream per element just to measure its
+// width, then stream every element a second time through setw. Here every
+// element is converted exactly once with std::to_chars (no locale, no stream
+// state, no allocation) into one reusable buffer, the widths come from those
+// results, and the whole matrix leaves in a single ostream::write.
+//
+//   formatMatrix  the usual "[ ... ]" layout. Floating point follows the
+//                 stream's precision and fixed/scientific flags like <<
+//                 would, so the output is unchanged. Flags to_chars can't
+//                 follow (hex/oct, showpos, showpoint, uppercase, showbase)
+//                 send the elements through a stream instead.
+//   writeCsv      one row per line, comma separated, shortest text that
+//                 reads back to the same value
+//   writeBinary   the raw elements row by row, without padding (native
+//                 byte order), e.g. for reading back with istream::read
+//
+// All three read elements through m(i, j), so they work for every matrix
+// type in the repo; rows and cols default to M::nrows and M::ncols.
+
+namespace mpcs51044 {
+
+namespace format {
+
+// Append the text of v to out
+template<typename T>
+void appendElement(string &out, T v, std::chars_format fmt, int precision, bool shortest)
+{
+	if constexpr (requires(char *p) { std::to_chars(p, p, v); }) {
+		size_t const start = out.size();
+		for (size_t room = 32;; room *= 2) {
+			out.resize(start + room);
+			char *first = out.data() + start;
+			std::to_chars_result result;
+			if constexpr (std::is_floating_point_v<T>) {
+				if (shortest)
+					result = std::to_chars(first, first + room, v);
+				else if (fmt == std::chars_format::hex)
+					result = std::to_chars(first, first + room, v, fmt);
+				else
+					result = std::to_chars(first, first + room, v, fmt, precision);
+			} else {
+				result = std::to_chars(first, first + room, v);
+			}
+			if (result.ec == std::errc{}) {
+				out.resize(result.ptr - out.data());
+				// hexfloat streams print the 0x that to_chars leaves off
+				if (fmt == std::chars_format::hex && !shortest)
+					out.insert(start + (out[start] == '-'), "0x");
+				return;
+			}
+		}
+	} else {
+		// No to_chars for this type: fall back on its operator<<
+		std::ostringstream ostr;
+		ostr.precision(precision);
+		ostr << v;
+		out += ostr.str();
+	}
+}
+
+// chars_format matching the stream's floatfield flags
+inline std::chars_format streamFormat(ostream const &os)
+{
+	switch (os.flags() & std::ios_base::floatfield) {
+	case std::ios_base::fixed: return std::chars_format::fixed;
+	case std::ios_base::scientific: return std::chars_format::scientific;
+	case std::ios_base::fixed | std::ios_base::scientific: return std::chars_format::hex;
+	default: return std::chars_format::general;
+	}
+}
+
+// Whether os has flags that change how << prints numbers but that to_chars
+// knows nothing about
+inline bool needsStream(ostream const &os)
+{
+	std::ios_base::fmtflags const f = os.flags();
+	std::ios_base::fmtflags const base = f & std::ios_base::basefield;
+	return (base != std::ios_base::dec && base != std::ios_base::fmtflags{})
+		|| (f & (std::ios_base::showpos | std::ios_base::showpoint | std::ios_base::uppercase | std::ios_base::showbase));
+}
+
+// Buffers reused from call to call (one set per thread)
+struct Buffers {
+	string text;
+	vector<size_t> ends;
+	string out;
+};
+inline Buffers &buffers()
+{
+	thread_local Buffers b;
+	return b;
+}
+
+// Flush out to os once it holds this much
+inline constexpr size_t chunkSize = 1 << 20;
+
+}
+
+template<typename M>
+ostream &formatMatrix(ostream &os, M const &m, int rows = M::nrows, int cols = M::ncols)
+{
+	auto &b = format::buffers();
+	b.text.clear();
+	b.ends.clear();
+	std::chars_format const fmt = format::streamFormat(os);
+	int const precision = static_cast<int>(os.precision());
+	bool const streamed = format::needsStream(os);
+	// Only made when streamed: one stream with os's flags for every element
+	std::optional<std::ostringstream> ostr;
+	if (streamed) {
+		ostr.emplace();
+		ostr->flags(os.flags());
+		ostr->precision(precision);
+		ostr->imbue(os.getloc());
+	}
+	size_t width = 0;
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			size_t const start = b.text.size();
+			if (streamed) {
+				ostr->str(string());
+				*ostr << m(i, j);
+				b.text += ostr->view();
+			} else {
+				format::appendElement(b.text, m(i, j), fmt, precision, false);
+			}
+			b.ends.push_back(b.text.size());
+			width = std::max(width, b.text.size() - start);
+		}
+	}
+	width += 2;
+
+	b.out.clear();
+	b.out.reserve(static_cast<size_t>(rows) * (cols * width + 1) + 5);
+	b.out += "[ \n";
+	size_t start = 0;
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			size_t const end = b.ends[static_cast<size_t>(i) * cols + j];
+			b.out.append(width - (end - start), ' ');
+			b.out.append(b.text, start, end - start);
+			start = end;
+		}
+		b.out += '\n';
+	}
+	b.out += "]\n";
+	os.write(b.out.data(), static_cast<std::streamsize>(b.out.size()));
+	return os;
+}
+
+template<typename M>
+ostream &writeCsv(ostream &os, M const &m, int rows = M::nrows, int cols = M::ncols)
+{
+	auto &b = format::buffers();
+	b.out.clear();
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			if (j)
+				b.out += ',';
+			format::appendElement(b.out, m(i, j), std::chars_format::general, 0, true);
+		}
+		b.out += '\n';
+		if (b.out.size() >= format::chunkSize) {
+			os.write(b.out.data(), static_cast<std::streamsize>(b.out.size()));
+			b.out.clear();
+		}
+	}
+	os.write(b.out.data(), static_cast<std::streamsize>(b.out.size()));
+	return os;
+}
+
+template<typename M>
+ostream &writeBinary(ostream &os, M const &m, int rows = M::nrows, int cols = M::ncols)
+{
+	using T = std::remove_cvref_t<decltype(m(0, 0))>;
+	static_assert(std::is_trivially_copyable_v<T>, "Binary dumps need a trivially copyable element type");
+	auto &b = format::buffers();
+	b.out.clear();
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j < cols; j++) {
+			T const v = m(i, j);
+			b.out.append(reinterpret_cast<char const *>(&v), sizeof(T));
+		}
+		if (b.out.size() >= format::chunkSize) {
+			os.write(b.out.data(), static_cast<std::streamsize>(b.out.size()));
+			b.out.clear();
+		}
+	}
+	os.write(b.out.data(), static_cast<std::streamsize>(b.out.size()));
+	return os;
+}
+
+}
+#endif
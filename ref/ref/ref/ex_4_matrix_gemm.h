@@ -0,0 +1,321 @@
+#ifndef MATRIX_GEMM_H
+#  define MATRIX_GEMM_H
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include "ex_4_matrix_simd.h"
+
+using std::ptrdiff_t;
+using std::min;
+using std::vector;
+
+//////////////////////////////////////////
+// CACHE-TILED GEMM (C += A * B)
+//////////////////////////////////////////
+// The textbook i-j-k loop walks down a column of B for every element of C,
+// so once B no longer fits in L1 almost every load is a cache miss.
+//
+// Instead (following the Goto/BLIS scheme):
+//   (1) split B into KC x NC panels that stay resident in L3
+//   (2) split A into MC x KC blocks that stay resident in L2
+//   (3) copy ("pack") both into contiguous buffers in exactly the order
+//       the micro-kernel will read them, so every load is sequential
+//   (4) a MR x NR micro-kernel keeps its block of C in registers for the
+//       whole KC-long inner loop, doing MR*NR multiply-adds per MR+NR loads
+//
+// The operands are anything with operator()(int, int), so the same kernel
+// works on plain row-major storage and on strided views.
+
+namespace mpcs51044 {
+
+// Read-only operand over memory with arbitrary row and column strides
+template<typename T>
+struct StridedOperand {
+	T const *p;
+	ptrdiff_t rs;
+	ptrdiff_t cs;
+	constexpr T operator()(int i, int j) const {
+		return p[i * rs + j * cs];
+	}
+};
+
+template<typename T>
+constexpr StridedOperand<T> rowMajor(T const *p, ptrdiff_t ld)
+{
+	return { p, ld, 1 };
+}
+
+// Operand that reads another operand multiplied by alpha, so C += alpha * A * B
+// folds the scaling into packing instead of a separate pass
+template<typename T, typename Operand>
+struct ScaledOperand {
+	T alpha;
+	Operand op;
+	constexpr T operator()(int i, int j) const {
+		return alpha * op(i, j);
+	}
+};
+
+// Register and cache block sizes. MR * NR accumulators have to fit in the
+// register file (16 SSE registers on x86-64), MC * KC elements of A in L2
+// and KC * NC elements of B in L3.
+template<typename T>
+struct GemmBlocking {
+	static constexpr int MR = 4;
+	static constexpr int NR = sizeof(T) >= 8 ? 4 : 8;
+	static constexpr int MC = 128;
+	static constexpr int KC = 256;
+	static constexpr int NC = 2048;
+};
+
+// Compile-time kernel selection from the (fixed) matrix dimensions: the
+// register block never exceeds the matrix, and products small enough to sit
+// in L1 skip packing entirely.
+template<typename T, int a, int b, int c>
+struct GemmShape {
+	static constexpr int MR = min(GemmBlocking<T>::MR, a);
+	static constexpr int NR = min(GemmBlocking<T>::NR, c);
+	static constexpr bool tiny = static_cast<long long>(a) * b * c <= 16 * 16 * 16;
+};
+
+// Copy rows [i0, i0+mc) x cols [p0, p0+kc) of A into MR-tall strips,
+// column-major within each strip. Short strips are zero padded.
+template<typename T, int MR, typename A>
+void packA(A const &a, int i0, int p0, int mc, int kc, T *dst)
+{
+	for (int ir = 0; ir < mc; ir += MR) {
+		int mr = min(MR, mc - ir);
+		for (int p = 0; p < kc; p++) {
+			for (int i = 0; i < MR; i++) {
+				*dst++ = i < mr ? a(i0 + ir + i, p0 + p) : T{};
+			}
+		}
+	}
+}
+
+// Copy rows [p0, p0+kc) x cols [j0, j0+nc) of B into NR-wide strips,
+// row-major within each strip. Narrow strips are zero padded.
+template<typename T, int NR, typename B>
+void packB(B const &b, int p0, int j0, int kc, int nc, T *dst)
+{
+	for (int jr = 0; jr < nc; jr += NR) {
+		int nr = min(NR, nc - jr);
+		for (int p = 0; p < kc; p++) {
+			for (int j = 0; j < NR; j++) {
+				*dst++ = j < nr ? b(p0 + p, j0 + jr + j) : T{};
+			}
+		}
+	}
+}
+
+// C[0:mr, 0:nr] += Apanel * Bpanel. The accumulator array is small and fixed
+// so the compiler keeps it entirely in registers.
+template<typename T, int MR, int NR>
+inline void gemmMicroKernel(int kc, T const *a, T const *b, T *c, ptrdiff_t ldc, int mr, int nr)
+{
+	T acc[MR][NR] = {};
+	for (int p = 0; p < kc; p++) {
+		for (int i = 0; i < MR; i++) {
+			for (int j = 0; j < NR; j++) {
+				acc[i][j] += a[i] * b[j];
+			}
+		}
+		a += MR;
+		b += NR;
+	}
+	if (mr == MR && nr == NR) {
+		for (int i = 0; i < MR; i++) {
+			for (int j = 0; j < NR; j++) {
+				c[i * ldc + j] += acc[i][j];
+			}
+		}
+	} else {
+		for (int i = 0; i < mr; i++) {
+			for (int j = 0; j < nr; j++) {
+				c[i * ldc + j] += acc[i][j];
+			}
+		}
+	}
+}
+
+// Portable micro-kernel; the vectorized ones live in ex_4_matrix_simd.h
+template<typename T, int mr_, int nr_>
+struct ScalarMicroKernel {
+	static constexpr int MR = mr_;
+	static constexpr int NR = nr_;
+	static void run(int kc, T const *a, T const *b, T *c, ptrdiff_t ldc, int mr, int nr) {
+		gemmMicroKernel<T, MR, NR>(kc, a, b, c, ldc, mr, nr);
+	}
+};
+
+// C (m x n, row-major with leading dimension ldc) += A (m x k) * B (k x n)
+template<typename T,
+	int MR = GemmBlocking<T>::MR,
+	int NR = GemmBlocking<T>::NR,
+	typename Kernel = ScalarMicroKernel<T, MR, NR>,
+	typename A, typename B>
+void gemm(int m, int n, int k, A const &a, B const &b, T *c, ptrdiff_t ldc)
+{
+	using Blocking = GemmBlocking<T>;
+	constexpr int MC = Blocking::MC - Blocking::MC % MR;
+	constexpr int KC = Blocking::KC;
+	constexpr int NC = Blocking::NC - Blocking::NC % NR;
+
+	int const mcMax = min(MC, (m + MR - 1) / MR * MR);
+	int const kcMax = min(KC, k);
+	int const ncMax = min(NC, (n + NR - 1) / NR * NR);
+	vector<T> aPacked(static_cast<size_t>(mcMax) * kcMax);
+	vector<T> bPacked(static_cast<size_t>(kcMax) * ncMax);
+
+	for (int jc = 0; jc < n; jc += NC) {
+		int nc = min(NC, n - jc);
+		for (int pc = 0; pc < k; pc += KC) {
+			int kc = min(KC, k - pc);
+			packB<T, NR>(b, pc, jc, kc, nc, bPacked.data());
+			for (int ic = 0; ic < m; ic += MC) {
+				int mc = min(MC, m - ic);
+				packA<T, MR>(a, ic, pc, mc, kc, aPacked.data());
+				for (int jr = 0; jr < nc; jr += NR) {
+					for (int ir = 0; ir < mc; ir += MR) {
+						Kernel::run(
+							kc,
+							aPacked.data() + static_cast<ptrdiff_t>(ir) * kc,
+							bPacked.data() + static_cast<ptrdiff_t>(jr) * kc,
+							c + (ic + ir) * ldc + jc + jr,
+							ldc,
+							min(MR, mc - ir),
+							min(NR, nc - jr));
+					}
+				}
+			}
+		}
+	}
+}
+
+// gemm() with the widest micro-kernel the CPU supports for float/double,
+// falling back to the portable MR x NR kernel. MR x NR is also the most the
+// vector kernels may use: left at GemmBlocking's defaults, each ISA uses its
+// full register block, but a dimension set below its default (GemmShape of a
+// matrix with fewer rows or columns than that) shrinks the vector kernel's
+// block to match, so it doesn't spend its multiply-adds on padding
+template<typename T, int MR = GemmBlocking<T>::MR, int NR = GemmBlocking<T>::NR, typename A, typename B>
+void dispatchGemm(int m, int n, int k, A const &a, B const &b, T *c, ptrdiff_t ldc)
+{
+#if MPCS51044_HAVE_SIMD
+	if constexpr (isSimdType<T>) {
+		constexpr int maxMR = MR != GemmBlocking<T>::MR ? MR : 1 << 16;
+		constexpr int maxNR = NR != GemmBlocking<T>::NR ? NR : 1 << 16;
+		switch (activeIsa()) {
+		case Isa::Avx512:
+			using K512 = simd::Avx512MicroKernel<T, maxMR, maxNR>;
+			return gemm<T, K512::MR, K512::NR, K512>(m, n, k, a, b, c, ldc);
+		case Isa::Avx2:
+			using K256 = simd::Avx2MicroKernel<T, maxMR, maxNR>;
+			return gemm<T, K256::MR, K256::NR, K256>(m, n, k, a, b, c, ldc);
+		case Isa::Sse2:
+			using K128 = simd::Sse2MicroKernel<T, maxMR, maxNR>;
+			return gemm<T, K128::MR, K128::NR, K128>(m, n, k, a, b, c, ldc);
+		default:
+			break;
+		}
+	}
+#endif
+	gemm<T, MR, NR>(m, n, k, a, b, c, ldc);
+}
+
+// out (a x c, leading dimension ldo) = (or += if accumulate) l (a x b) * r (b x c)
+// as a straight i-j-k loop
+template<typename T, int a, int b, int c, bool accumulate, typename L, typename R>
+constexpr void multiplySimple(L const &l, R const &r, T *out, ptrdiff_t ldo)
+{
+	for (int i = 0; i < a; i++) {
+		for (int j = 0; j < c; j++) {
+			T total = 0;
+			for (int k = 0; k < b; k++)
+				total += l(i, k) * r(k, j);
+			if constexpr (accumulate)
+				out[i * ldo + j] += total;
+			else
+				out[i * ldo + j] = total;
+		}
+	}
+}
+
+// out (a x c, leading dimension ldo) = l (a x b) * r (b x c) for sizes known
+// at compile time. Tiny products use a straight loop, matrix-vector products
+// with contiguous rows go to the gemv kernel, and everything else is zeroed
+// and handed to the tiled kernel with a register block sized for it.
+// In a constant expression (no SIMD or heap buffers there) it is always the
+// straight loop.
+template<typename T, int a, int b, int c, typename L, typename R>
+constexpr void multiplyInto(L const &l, R const &r, T *out, ptrdiff_t ldo)
+{
+	using Shape = GemmShape<T, a, b, c>;
+	if (std::is_constant_evaluated()) {
+		multiplySimple<T, a, b, c, false>(l, r, out, ldo);
+		return;
+	}
+	constexpr bool strided = std::is_same_v<L, StridedOperand<T>> && std::is_same_v<R, StridedOperand<T>>;
+	if constexpr (c == 1 && strided && isSimdType<T>) {
+		if (l.cs == 1 && r.rs == 1 && ldo == 1) {
+			simdKernels<T>().gemv(a, b, l.p, l.rs, r.p, out);
+			return;
+		}
+	}
+	if constexpr (Shape::tiny) {
+		multiplySimple<T, a, b, c, false>(l, r, out, ldo);
+	} else {
+		for (int i = 0; i < a; i++) {
+			std::fill(out + i * ldo, out + i * ldo + c, T{});
+		}
+		dispatchGemm<T, Shape::MR, Shape::NR>(a, c, b, l, r, out, ldo);
+	}
+}
+
+// multiplyInto() for sizes only known at runtime (DynamicMatrix)
+template<typename T, typename L, typename R>
+void multiplyInto(int a, int b, int c, L const &l, R const &r, T *out, ptrdiff_t ldo)
+{
+	constexpr bool strided = std::is_same_v<L, StridedOperand<T>> && std::is_same_v<R, StridedOperand<T>>;
+	if constexpr (strided && isSimdType<T>) {
+		if (c == 1 && l.cs == 1 && r.rs == 1 && ldo == 1) {
+			simdKernels<T>().gemv(a, b, l.p, l.rs, r.p, out);
+			return;
+		}
+	}
+	if (static_cast<long long>(a) * b * c <= 16 * 16 * 16) {
+		for (int i = 0; i < a; i++) {
+			for (int j = 0; j < c; j++) {
+				T total = 0;
+				for (int k = 0; k < b; k++)
+					total += l(i, k) * r(k, j);
+				out[i * ldo + j] = total;
+			}
+		}
+	} else {
+		for (int i = 0; i < a; i++) {
+			std::fill(out + i * ldo, out + i * ldo + c, T{});
+		}
+		dispatchGemm<T>(a, c, b, l, r, out, ldo);
+	}
+}
+
+// out (a x c, leading dimension ldo) += l (a x b) * r (b x c)
+template<typename T, int a, int b, int c, typename L, typename R>
+constexpr void multiplyAccumulate(L const &l, R const &r, T *out, ptrdiff_t ldo)
+{
+	using Shape = GemmShape<T, a, b, c>;
+	if (std::is_constant_evaluated()) {
+		multiplySimple<T, a, b, c, true>(l, r, out, ldo);
+		return;
+	}
+	if constexpr (Shape::tiny) {
+		multiplySimple<T, a, b, c, true>(l, r, out, ldo);
+	} else {
+		dispatchGemm<T, Shape::MR, Shape::NR>(a, c, b, l, r, out, ldo);
+	}
+}
+
+}
+#endif
@@ -0,0 +1,282 @@
+#ifndef MATRIX_LU_H
+#  define MATRIX_LU_H
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_triangular.h"
+
+using std::ptrdiff_t;
+using std::min;
+using std::swap;
+using std::vector;
+
+//////////////////////////////////////////
+// LU DECOMPOSITION WITH PARTIAL PIVOTING
+//////////////////////////////////////////
+// Cofactor expansion along a column costs n * (cost of an (n-1)x(n-1) determinant),
+// i.e. O(n!), and instantiates a Matrix template for every size below n.
+// Gaussian elimination factors P*A = L*U in O(n^3), after which
+// det(A) = (-1)^(number of row swaps) * product of the diagonal of U.
+//
+// The factorization is right-looking and blocked: a narrow panel of columns
+// is eliminated directly, then the rest of the matrix is updated with one
+// big matrix product, which is where nearly all the flops are and which the
+// tiled GEMM kernel handles at full speed.
+
+namespace mpcs51044 {
+
+// Operand that reads another operand with its sign flipped, so that
+// the trailing update C -= A * B can reuse the C += A * B kernel
+template<typename Operand>
+struct NegatedOperand {
+	Operand op;
+	auto operator()(int i, int j) const {
+		return -op(i, j);
+	}
+};
+
+// Does the trailing update of luFactor() on this thread. ParallelGemm in
+// ex_4_matrix_parallel.h is a drop-in replacement that uses a thread pool.
+struct SerialGemm {
+	template<typename T, typename A, typename B>
+	void operator()(int m, int n, int k, A const &a, B const &b, T *c, ptrdiff_t ldc) const {
+		dispatchGemm<T>(m, n, k, a, b, c, ldc);
+	}
+};
+
+// Factor the n x n row-major matrix at a in place into unit-lower L (below the
+// diagonal) and U (on and above it). piv[i] is the row that was swapped with
+// row i at step i. Returns the sign of the permutation, or 0 if the matrix is
+// singular.
+template<typename T, typename Gemm = SerialGemm>
+int luFactor(int n, T *a, ptrdiff_t lda, int *piv, Gemm const &gemm = {})
+{
+	constexpr int NB = 32;
+	int sign = 1;
+	for (int k0 = 0; k0 < n; k0 += NB) {
+		int const kEnd = min(k0 + NB, n);
+
+		// (1) eliminate the panel a[k0:n, k0:kEnd)
+		for (int k = k0; k < kEnd; k++) {
+			int p = k;
+			T best = a[k * lda + k] < 0 ? -a[k * lda + k] : a[k * lda + k];
+			for (int i = k + 1; i < n; i++) {
+				T v = a[i * lda + k] < 0 ? -a[i * lda + k] : a[i * lda + k];
+				if (v > best) {
+					best = v;
+					p = i;
+				}
+			}
+			piv[k] = p;
+			if (best == T{}) {
+				sign = 0;
+				continue;
+			}
+			if (p != k) {
+				std::swap_ranges(a + k * lda, a + k * lda + n, a + p * lda);
+				sign = -sign;
+			}
+			T const pivot = a[k * lda + k];
+			for (int i = k + 1; i < n; i++) {
+				T &l = a[i * lda + k];
+				l /= pivot;
+				for (int j = k + 1; j < kEnd; j++) {
+					a[i * lda + j] -= l * a[k * lda + j];
+				}
+			}
+		}
+		if (kEnd == n) {
+			break;
+		}
+
+		// (2) U12 = L11^-1 * A12
+		for (int i = k0 + 1; i < kEnd; i++) {
+			for (int p = k0; p < i; p++) {
+				T const l = a[i * lda + p];
+				for (int j = kEnd; j < n; j++) {
+					a[i * lda + j] -= l * a[p * lda + j];
+				}
+			}
+		}
+
+		// (3) A22 -= L21 * U12
+		gemm(n - kEnd, n - kEnd, kEnd - k0,
+			NegatedOperand<StridedOperand<T>>{ rowMajor<T>(a + kEnd * lda + k0, lda) },
+			rowMajor<T>(a + k0 * lda + kEnd, lda),
+			a + kEnd * lda + kEnd, lda);
+	}
+	return sign;
+}
+
+// det(a) by plain (unblocked) elimination with partial pivoting, for constant
+// expressions, where the kernels and buffers luFactor() uses aren't
+// available. a is anything with operator()(int, int).
+template<typename T, typename A>
+constexpr T eliminationDeterminant(int n, A const &a)
+{
+	vector<T> m(static_cast<size_t>(n) * n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			m[i * n + j] = a(i, j);
+	T det = 1;
+	for (int k = 0; k < n; k++) {
+		int p = k;
+		T best = m[k * n + k] < 0 ? -m[k * n + k] : m[k * n + k];
+		for (int i = k + 1; i < n; i++) {
+			T const v = m[i * n + k] < 0 ? -m[i * n + k] : m[i * n + k];
+			if (v > best) {
+				best = v;
+				p = i;
+			}
+		}
+		if (best == T{})
+			return T{};
+		if (p != k) {
+			std::swap_ranges(m.begin() + k * n, m.begin() + (k + 1) * n, m.begin() + p * n);
+			det = -det;
+		}
+		det *= m[k * n + k];
+		for (int i = k + 1; i < n; i++) {
+			T const l = m[i * n + k] / m[k * n + k];
+			for (int j = k + 1; j < n; j++)
+				m[i * n + j] -= l * m[k * n + j];
+		}
+	}
+	return det;
+}
+
+// Size template argument for matrices whose size is only known at runtime
+inline constexpr int dynamicSize = -1;
+
+// A reusable P*A = L*U factorization of an n x n matrix. With
+// n == dynamicSize the size is a constructor argument instead. The
+// factoring is the O(n^3) part; every solve afterwards is O(n^2) per
+// right-hand side (see ex_4_matrix_triangular.h).
+template<typename T, int n = dynamicSize>
+class LUDecomposition {
+	static_assert(std::is_floating_point_v<T>, "LU decomposition needs a floating point element type");
+public:
+	// Factor the row-major matrix at src (leading dimension ld)
+	LUDecomposition(T const *src, ptrdiff_t ld) requires (n != dynamicSize) : dim(n) {
+		factorFrom(src, ld, SerialGemm{});
+	}
+
+	// Same, with the trailing updates done by gemm (see SerialGemm)
+	template<typename Gemm>
+	LUDecomposition(T const *src, ptrdiff_t ld, Gemm const &gemm) requires (n != dynamicSize) : dim(n) {
+		factorFrom(src, ld, gemm);
+	}
+
+	// Runtime-sized versions of the two above
+	LUDecomposition(int size, T const *src, ptrdiff_t ld) requires (n == dynamicSize) : dim(size) {
+		factorFrom(src, ld, SerialGemm{});
+	}
+
+	template<typename Gemm>
+	LUDecomposition(int size, T const *src, ptrdiff_t ld, Gemm const &gemm) requires (n == dynamicSize) : dim(size) {
+		factorFrom(src, ld, gemm);
+	}
+
+	int size() const {
+		return dim;
+	}
+
+	T determinant() const {
+		T val = static_cast<T>(sign);
+		for (int i = 0; i < dim && val != T{}; i++) {
+			val *= lu[i * dim + i];
+		}
+		return val;
+	}
+
+	bool singular() const {
+		return sign == 0;
+	}
+
+	// Packed factors: L below the diagonal (unit diagonal implied), U on and above
+	T factor(int x, int y) const {
+		return lu[x * dim + y];
+	}
+
+	int pivot(int i) const {
+		return pivots[i];
+	}
+
+	// Solve A * x = b in O(n^2) with the stored factors: b (size() elements)
+	// is overwritten with x. Throws std::domain_error if A is singular.
+	void solve(T *b) const {
+		checkSolvable();
+		permute(1, b, 1);
+		triangularSolve(Triangle::Lower, true, dim, lu.data(), dim, b);
+		triangularSolve(Triangle::Upper, false, dim, lu.data(), dim, b);
+	}
+
+	vector<T> solve(vector<T> b) const {
+		if (static_cast<int>(b.size()) != dim)
+			throw std::invalid_argument("Matrix and vector sizes must match");
+		solve(b.data());
+		return b;
+	}
+
+	// Solve A * X = B for the nrhs columns of the row-major size() x nrhs B
+	// (leading dimension ldb) at once, overwriting B with X
+	void solveMany(int nrhs, T *b, ptrdiff_t ldb) const {
+		checkSolvable();
+		permute(nrhs, b, ldb);
+		triangularSolve(Triangle::Lower, true, dim, lu.data(), dim, nrhs, b, ldb);
+		triangularSolve(Triangle::Upper, false, dim, lu.data(), dim, nrhs, b, ldb);
+	}
+
+	// Same for a Matrix or DynamicMatrix B, returning X
+	template<typename M>
+	M solveMany(M b) const {
+		if (rowsOf(b) != dim)
+			throw std::invalid_argument("Matrix sizes must match");
+		solveMany(colsOf(b), b.storage(), ldOf(b));
+		return b;
+	}
+
+	// A^-1, row-major into out (leading dimension ldo)
+	void inverse(T *out, ptrdiff_t ldo) const {
+		for (int i = 0; i < dim; i++)
+			for (int j = 0; j < dim; j++)
+				out[i * ldo + j] = i == j ? T{ 1 } : T{};
+		solveMany(dim, out, ldo);
+	}
+
+private:
+	void checkSolvable() const {
+		if (singular())
+			throw std::domain_error("Can't solve with a singular matrix");
+	}
+
+	// Apply the row swaps of P to the rows of b
+	void permute(int nrhs, T *b, ptrdiff_t ldb) const {
+		for (int i = 0; i < dim; i++) {
+			if (pivots[i] != i)
+				std::swap_ranges(b + i * ldb, b + i * ldb + nrhs, b + pivots[i] * ldb);
+		}
+	}
+
+	template<typename Gemm>
+	void factorFrom(T const *src, ptrdiff_t ld, Gemm const &gemm) {
+		lu.resize(static_cast<size_t>(dim) * dim);
+		pivots.resize(dim);
+		for (int i = 0; i < dim; i++) {
+			std::copy(src + i * ld, src + i * ld + dim, lu.begin() + i * dim);
+		}
+		sign = luFactor(dim, lu.data(), dim, pivots.data(), gemm);
+	}
+
+	int dim;
+	vector<T> lu;
+	vector<int> pivots;
+	int sign = 0;
+};
+
+}
+#endif
@@ -0,0 +1,46 @@
+#include "ex_4_matrix_parallel.h"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+using namespace mpcs51044_ps;
+using namespace std;
+
+// 2048x2048 multiply and determinant, single-threaded and on the thread pool
+int main()
+{
+	constexpr int n = 2048;
+	auto l = make_unique<Matrix<double, n, n>>();
+	auto r = make_unique<Matrix<double, n, n>>();
+	mt19937 gen(51044);
+	uniform_real_distribution<double> dist(-1, 1);
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			// Near the identity so the determinant stays representable
+			(*l)(i, j) = (i == j) + dist(gen) / n;
+			(*r)(i, j) = dist(gen);
+		}
+	}
+	cout << "threads: " << thread_pool::instance().size() + 1 << '\n';
+
+	auto start = chrono::steady_clock::now();
+	auto serial = make_unique<Matrix<double, n, n>>(*l * *r);
+	cout << "multiply:          " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	start = chrono::steady_clock::now();
+	auto parallel = make_unique<Matrix<double, n, n>>(parallel_multiply(*l, *r));
+	cout << "parallel_multiply: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	double diff = 0;
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			diff = max(diff, abs((*serial)(i, j) - (*parallel)(i, j)));
+	cout << "max difference: " << diff << '\n';
+
+	start = chrono::steady_clock::now();
+	double det = l->determinant();
+	cout << "determinant:          " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	start = chrono::steady_clock::now();
+	double parallelDet = parallel_determinant(*l);
+	cout << "parallel_determinant: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	cout << det << " vs " << parallelDet << endl;
+}
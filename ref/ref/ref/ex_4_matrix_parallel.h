@@ -0,0 +1,106 @@
+#ifndef MATRIX_PARALLEL_H
+#  define MATRIX_PARALLEL_H
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include "ex_4_PSMatrix.h"
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_lu.h"
+#include "ex_7_thread_pool.h"
+
+using std::ptrdiff_t;
+
+//////////////////////////////////////////
+// MULTITHREADED MULTIPLY AND LU
+//////////////////////////////////////////
+// C += A * B splits naturally into independent horizontal slabs: rows
+// [i0, i1) of C only need rows [i0, i1) of A (and all of B). Each thread runs
+// the ordinary tiled kernel on its own slab, so it packs its own copy of B,
+// which costs k * n copies against 2 * (i1 - i0) * n * k flops.
+//
+// The slabs are handed to a persistent thread_pool with parallel_for
+// (ex_7_thread_pool.h), so the blocked LU factorization, which does one
+// trailing-update product per 32-column panel, doesn't start threads for
+// each of them. The panels themselves are still factored on one thread;
+// they are O(n^2) work against the O(n^3) of the updates.
+
+namespace mpcs51044 {
+
+// Operand whose (0, 0) is op's (i0, j0)
+template<typename Operand>
+struct OffsetOperand {
+	Operand op;
+	int i0;
+	int j0;
+	auto operator()(int i, int j) const {
+		return op(i0 + i, j0 + j);
+	}
+};
+
+// C (m x n, leading dimension ldc) += A (m x k) * B (k x n) on pool.
+template<typename T, typename A, typename B>
+void parallelGemm(int m, int n, int k, A const &a, B const &b, T *c, ptrdiff_t ldc,
+	thread_pool &pool = thread_pool::instance())
+{
+	// Slabs are whole 8-row strips with at least ~1M multiply-adds each, so
+	// that small products (and the last few LU updates) stay on one thread
+	constexpr int strip = 8;
+	long long const perStrip = static_cast<long long>(strip) * n * k;
+	int const minStrips = static_cast<int>(std::max<long long>(1, (1LL << 20) / std::max<long long>(perStrip, 1)));
+	int const strips = (m + strip - 1) / strip;
+	parallel_for(0, strips, minStrips, [&](int s0, int s1) {
+		int const i0 = s0 * strip;
+		int const i1 = std::min(s1 * strip, m);
+		dispatchGemm<T>(i1 - i0, n, k, OffsetOperand<A>{ a, i0, 0 }, b, c + i0 * ldc, ldc);
+	}, pool);
+}
+
+// Trailing-update policy for luFactor() / LUDecomposition that uses parallelGemm
+struct ParallelGemm {
+	thread_pool *pool;
+	template<typename T, typename A, typename B>
+	void operator()(int m, int n, int k, A const &a, B const &b, T *c, ptrdiff_t ldc) const {
+		parallelGemm<T>(m, n, k, a, b, c, ldc, *pool);
+	}
+};
+
+}
+
+namespace mpcs51044_ps {
+using mpcs51044::thread_pool;
+
+// l * r with the rows of the result split across pool
+template<typename T, int a, int b, int c,
+	template<typename, int, int> class S1, template<typename, int, int> class S2>
+Matrix<T, a, c, S1>
+parallel_multiply(Matrix<T, a, b, S1> const &l, Matrix<T, b, c, S2> const &r,
+	thread_pool &pool = thread_pool::instance())
+{
+	Matrix<T, a, c, S1> result; // storage starts zeroed
+	mpcs51044::parallelGemm<T>(a, c, b,
+		mpcs51044::rowMajor(l.storage(), l.ld),
+		mpcs51044::rowMajor(r.storage(), r.ld),
+		result.storage(), result.ld, pool);
+	return result;
+}
+
+// Matrix::factorize() with the trailing updates split across pool
+template<typename T, int n, template<typename, int, int> class S>
+mpcs51044::LUDecomposition<T, n>
+parallel_factorize(Matrix<T, n, n, S> const &m, thread_pool &pool = thread_pool::instance())
+{
+	return { m.storage(), m.ld, mpcs51044::ParallelGemm{ &pool } };
+}
+
+template<typename T, int n, template<typename, int, int> class S>
+T parallel_determinant(Matrix<T, n, n, S> const &m, thread_pool &pool = thread_pool::instance())
+{
+	if constexpr (std::is_floating_point_v<T> && n > 3) {
+		return parallel_factorize(m, pool).determinant();
+	} else {
+		return m.determinant();
+	}
+}
+
+}
+#endif
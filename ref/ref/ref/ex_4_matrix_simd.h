@@ -0,0 +1,447 @@
+#ifndef MATRIX_SIMD_H
+#  define MATRIX_SIMD_H
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+using std::ptrdiff_t;
+using std::size_t;
+using std::min;
+
+//////////////////////////////////////////
+// SIMD KERNELS WITH RUNTIME ISA DISPATCH
+//////////////////////////////////////////
+// The kernels below are written once, generic in the vector width W, using
+// GCC/Clang vector types (T __attribute__((vector_size(...)))). Each one is
+// then compiled three more times by thin wrappers carrying
+// __attribute__((target(...))) for SSE2, AVX2+FMA and AVX-512F. flatten
+// inlines the generic body into the wrapper, so the body is code-generated
+// for that ISA even though the rest of the program is built for the
+// baseline.
+//
+// At startup we ask the CPU (cpuid, through __builtin_cpu_supports) which
+// of those it can run and fill a table of function pointers once. One binary
+// therefore uses AVX-512 where it exists and still runs on older machines.
+//
+// Other compilers/architectures get the scalar table only.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  define MPCS51044_HAVE_SIMD 1
+#else
+#  define MPCS51044_HAVE_SIMD 0
+#endif
+
+namespace mpcs51044 {
+
+enum class Isa { Scalar, Sse2, Avx2, Avx512 };
+
+inline Isa detectIsa()
+{
+#if MPCS51044_HAVE_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return Isa::Avx512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return Isa::Avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return Isa::Sse2;
+#endif
+	return Isa::Scalar;
+}
+
+// Detected once, the first time any kernel is needed
+inline Isa activeIsa()
+{
+	static Isa const isa = detectIsa();
+	return isa;
+}
+
+inline char const *isaName(Isa isa)
+{
+	switch (isa) {
+	case Isa::Avx512: return "avx512";
+	case Isa::Avx2: return "avx2";
+	case Isa::Sse2: return "sse2";
+	default: return "scalar";
+	}
+}
+
+template<typename T>
+inline constexpr bool isSimdType = std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+// Loads and stores of either one element (V == T) or a whole vector of them
+template<typename V, typename T>
+inline V const &at(T const *p)
+{
+	return *reinterpret_cast<V const *>(p);
+}
+
+template<typename V, typename T>
+inline V &at(T *p)
+{
+	return *reinterpret_cast<V *>(p);
+}
+
+// Tells a forEachLane() body whether it is processing W-lane vectors or
+// (W == 1) single elements; type is what to pass to at<>()
+template<typename T, int W = 1>
+struct LaneTag;
+
+template<typename T>
+struct LaneTag<T, 1> {
+	using type = T;
+};
+
+//////////////////////////////////////////
+// Scalar reference kernels
+//////////////////////////////////////////
+namespace scalar {
+
+// out = a + b
+template<typename T>
+void add(size_t n, T const *a, T const *b, T *out)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = a[i] + b[i];
+}
+
+// out = alpha * a
+template<typename T>
+void scale(size_t n, T alpha, T const *a, T *out)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = alpha * a[i];
+}
+
+// y (m) = A (m x n) * x (n)
+template<typename T>
+void gemv(int m, int n, T const *a, ptrdiff_t lda, T const *x, T *y)
+{
+	for (int i = 0; i < m; i++) {
+		T total = 0;
+		for (int j = 0; j < n; j++)
+			total += a[i * lda + j] * x[j];
+		y[i] = total;
+	}
+}
+
+// B (n x m) = A (m x n) transposed, in cache-sized tiles so that neither
+// the reads nor the writes stride through more than a tile of lines
+template<typename T>
+void transpose(int m, int n, T const *a, ptrdiff_t lda, T *b, ptrdiff_t ldb)
+{
+	constexpr int Tile = 32;
+	for (int i0 = 0; i0 < m; i0 += Tile) {
+		for (int j0 = 0; j0 < n; j0 += Tile) {
+			int const iEnd = min(i0 + Tile, m);
+			int const jEnd = min(j0 + Tile, n);
+			for (int i = i0; i < iEnd; i++)
+				for (int j = j0; j < jEnd; j++)
+					b[j * ldb + i] = a[i * lda + j];
+		}
+	}
+}
+
+}
+
+#if MPCS51044_HAVE_SIMD
+//////////////////////////////////////////
+// Width-generic vector kernels
+//////////////////////////////////////////
+namespace simd {
+
+template<typename T, int W>
+struct Vector {
+	// aligned(sizeof(T)) allows unaligned addresses and may_alias lets us read
+	// and write arrays of T through it (compiles to movu loads/stores)
+	typedef T type __attribute__((vector_size(W * sizeof(T)), aligned(sizeof(T)), may_alias));
+};
+
+}
+
+// Spelled through Vector<T, W>::type rather than passed in as a template
+// argument, which would drop the alignment and aliasing attributes
+template<typename T, int W>
+struct LaneTag {
+	using type = typename simd::Vector<T, W>::type;
+};
+
+namespace simd {
+
+template<typename T, int W>
+inline void add(size_t n, T const *a, T const *b, T *out)
+{
+	using V = typename Vector<T, W>::type;
+	size_t i = 0;
+	for (; i + W <= n; i += W)
+		at<V>(out + i) = at<V>(a + i) + at<V>(b + i);
+	for (; i < n; i++)
+		out[i] = a[i] + b[i];
+}
+
+template<typename T, int W>
+inline void scale(size_t n, T alpha, T const *a, T *out)
+{
+	using V = typename Vector<T, W>::type;
+	V const va = V{} + alpha;
+	size_t i = 0;
+	for (; i + W <= n; i += W)
+		at<V>(out + i) = va * at<V>(a + i);
+	for (; i < n; i++)
+		out[i] = alpha * a[i];
+}
+
+// Two independent accumulators per row hide the latency of the adds
+template<typename T, int W>
+inline void gemv(int m, int n, T const *a, ptrdiff_t lda, T const *x, T *y)
+{
+	using V = typename Vector<T, W>::type;
+	for (int i = 0; i < m; i++) {
+		T const *row = a + i * lda;
+		V acc0 = {}, acc1 = {};
+		int j = 0;
+		for (; j + 2 * W <= n; j += 2 * W) {
+			acc0 += at<V>(row + j) * at<V>(x + j);
+			acc1 += at<V>(row + j + W) * at<V>(x + j + W);
+		}
+		for (; j + W <= n; j += W)
+			acc0 += at<V>(row + j) * at<V>(x + j);
+		acc0 += acc1;
+		T total = 0;
+		for (int l = 0; l < W; l++)
+			total += acc0[l];
+		for (; j < n; j++)
+			total += row[j] * x[j];
+		y[i] = total;
+	}
+}
+
+// W x W register tiles inside 32 x 32 cache tiles: W rows are loaded as
+// vectors and written back out as W columns
+template<typename T, int W>
+inline void transpose(int m, int n, T const *a, ptrdiff_t lda, T *b, ptrdiff_t ldb)
+{
+	using V = typename Vector<T, W>::type;
+	constexpr int Tile = 32;
+	for (int i0 = 0; i0 < m; i0 += Tile) {
+		for (int j0 = 0; j0 < n; j0 += Tile) {
+			int const iEnd = min(i0 + Tile, m);
+			int const jEnd = min(j0 + Tile, n);
+			int i = i0;
+			for (; i + W <= iEnd; i += W) {
+				int j = j0;
+				for (; j + W <= jEnd; j += W) {
+					V rows[W];
+					for (int r = 0; r < W; r++)
+						rows[r] = at<V>(a + (i + r) * lda + j);
+					for (int c = 0; c < W; c++) {
+						V col;
+						for (int r = 0; r < W; r++)
+							col[r] = rows[r][c];
+						at<V>(b + (j + c) * ldb + i) = col;
+					}
+				}
+				for (; j < jEnd; j++)
+					for (int r = 0; r < W; r++)
+						b[j * ldb + i + r] = a[(i + r) * lda + j];
+			}
+			for (; i < iEnd; i++)
+				for (int j = j0; j < jEnd; j++)
+					b[j * ldb + i] = a[i * lda + j];
+		}
+	}
+}
+
+// GEMM micro-kernel: C[0:mr, 0:nr] += Apanel * Bpanel with the MR x NR block
+// of C held in MR * NR / W vector registers
+template<typename T, int W, int MR, int NR>
+inline void gemmMicroKernel(int kc, T const *a, T const *b, T *c, ptrdiff_t ldc, int mr, int nr)
+{
+	static_assert(NR % W == 0, "NR must be a whole number of vectors");
+	using V = typename Vector<T, W>::type;
+	constexpr int NV = NR / W;
+	V acc[MR][NV] = {};
+	for (int p = 0; p < kc; p++) {
+		V bv[NV];
+		for (int j = 0; j < NV; j++)
+			bv[j] = at<V>(b + j * W);
+		for (int i = 0; i < MR; i++) {
+			V const av = V{} + a[i];
+			for (int j = 0; j < NV; j++)
+				acc[i][j] += av * bv[j];
+		}
+		a += MR;
+		b += NR;
+	}
+	if (mr == MR && nr == NR) {
+		for (int i = 0; i < MR; i++)
+			for (int j = 0; j < NV; j++)
+				at<V>(c + i * ldc + j * W) += acc[i][j];
+	} else {
+		T tile[MR][NR];
+		for (int i = 0; i < MR; i++)
+			for (int j = 0; j < NV; j++)
+				at<V>(&tile[i][j * W]) = acc[i][j];
+		for (int i = 0; i < mr; i++)
+			for (int j = 0; j < nr; j++)
+				c[i * ldc + j] += tile[i][j];
+	}
+}
+
+// body(LaneTag<T, W>{}, i) for i = 0, W, 2W, ..., then body(LaneTag<T>{}, i)
+// for the leftover elements. A body written in terms of at<V>(p + i) with
+// V = LaneTag::type is thereby both the vector loop and its scalar tail.
+template<typename T, int W, typename Body>
+inline void forEachLane(size_t n, Body const &body)
+{
+	size_t i = 0;
+	for (; i + W <= n; i += W)
+		body(LaneTag<T, W>{}, i);
+	for (; i < n; i++)
+		body(LaneTag<T>{}, i);
+}
+
+//////////////////////////////////////////
+// Per-ISA instantiations
+//////////////////////////////////////////
+// Register blocks: SSE2 has 16 128-bit registers, AVX2 16 256-bit registers
+// (6 x 8 doubles = 12 accumulators + 2 for B + 1 broadcast) and AVX-512
+// 32 512-bit registers. A MicroKernel can be asked for a smaller block
+// (maxMR x maxNR, with the columns rounded up to whole vectors) for matrices
+// that are narrower than the full one.
+template<typename T>
+struct Sse2 {
+	static constexpr int W = 16 / sizeof(T);
+	static constexpr int MR = 4;
+	static constexpr int NR = 2 * W;
+};
+template<typename T>
+struct Avx2 {
+	static constexpr int W = 32 / sizeof(T);
+	static constexpr int MR = 6;
+	static constexpr int NR = 2 * W;
+};
+template<typename T>
+struct Avx512 {
+	static constexpr int W = 64 / sizeof(T);
+	static constexpr int MR = 8;
+	static constexpr int NR = 2 * W;
+};
+
+#  define MPCS51044_SIMD_WRAPPERS(Name, Target)                                                        \
+	template<typename T>                                                                              \
+	__attribute__((target(Target), flatten))                                                          \
+	void add##Name(size_t n, T const *a, T const *b, T *out)                                          \
+	{                                                                                                 \
+		add<T, Name<T>::W>(n, a, b, out);                                                             \
+	}                                                                                                 \
+	template<typename T>                                                                              \
+	__attribute__((target(Target), flatten))                                                          \
+	void scale##Name(size_t n, T alpha, T const *a, T *out)                                           \
+	{                                                                                                 \
+		scale<T, Name<T>::W>(n, alpha, a, out);                                                       \
+	}                                                                                                 \
+	template<typename T>                                                                              \
+	__attribute__((target(Target), flatten))                                                          \
+	void gemv##Name(int m, int n, T const *a, ptrdiff_t lda, T const *x, T *y)                        \
+	{                                                                                                 \
+		gemv<T, Name<T>::W>(m, n, a, lda, x, y);                                                      \
+	}                                                                                                 \
+	template<typename T>                                                                              \
+	__attribute__((target(Target), flatten))                                                          \
+	void transpose##Name(int m, int n, T const *a, ptrdiff_t lda, T *b, ptrdiff_t ldb)                \
+	{                                                                                                 \
+		transpose<T, Name<T>::W>(m, n, a, lda, b, ldb);                                               \
+	}                                                                                                 \
+	template<typename T, typename Body>                                                               \
+	__attribute__((target(Target), flatten))                                                          \
+	void forEachLane##Name(size_t n, Body const &body)                                                \
+	{                                                                                                 \
+		forEachLane<T, Name<T>::W>(n, body);                                                          \
+	}                                                                                                 \
+	template<typename T, int maxMR = Name<T>::MR, int maxNR = Name<T>::NR>                            \
+	struct Name##MicroKernel {                                                                        \
+		static constexpr int MR = min(Name<T>::MR, maxMR);                                            \
+		static constexpr int NR = min(Name<T>::NR, (maxNR + Name<T>::W - 1) / Name<T>::W * Name<T>::W); \
+		__attribute__((target(Target), flatten))                                                      \
+		static void run(int kc, T const *a, T const *b, T *c, ptrdiff_t ldc, int mr, int nr)          \
+		{                                                                                             \
+			gemmMicroKernel<T, Name<T>::W, MR, NR>(kc, a, b, c, ldc, mr, nr);                         \
+		}                                                                                             \
+	};
+
+MPCS51044_SIMD_WRAPPERS(Sse2, "sse2")
+MPCS51044_SIMD_WRAPPERS(Avx2, "avx2,fma")
+MPCS51044_SIMD_WRAPPERS(Avx512, "avx512f")
+#  undef MPCS51044_SIMD_WRAPPERS
+
+}
+#endif
+
+//////////////////////////////////////////
+// Dispatch table, filled once from activeIsa()
+//////////////////////////////////////////
+template<typename T>
+struct SimdKernels {
+	void (*add)(size_t n, T const *a, T const *b, T *out);
+	void (*scale)(size_t n, T alpha, T const *a, T *out);
+	void (*gemv)(int m, int n, T const *a, ptrdiff_t lda, T const *x, T *y);
+	void (*transpose)(int m, int n, T const *a, ptrdiff_t lda, T *b, ptrdiff_t ldb);
+};
+
+template<typename T>
+SimdKernels<T> makeSimdKernels(Isa isa)
+{
+	SimdKernels<T> k{ scalar::add<T>, scalar::scale<T>, scalar::gemv<T>, scalar::transpose<T> };
+#if MPCS51044_HAVE_SIMD
+	if constexpr (isSimdType<T>) {
+		switch (isa) {
+		case Isa::Avx512:
+			k = { simd::addAvx512<T>, simd::scaleAvx512<T>, simd::gemvAvx512<T>, simd::transposeAvx512<T> };
+			break;
+		case Isa::Avx2:
+			k = { simd::addAvx2<T>, simd::scaleAvx2<T>, simd::gemvAvx2<T>, simd::transposeAvx2<T> };
+			break;
+		case Isa::Sse2:
+			k = { simd::addSse2<T>, simd::scaleSse2<T>, simd::gemvSse2<T>, simd::transposeSse2<T> };
+			break;
+		default:
+			break;
+		}
+	}
+#endif
+	return k;
+}
+
+template<typename T>
+SimdKernels<T> const &simdKernels()
+{
+	static SimdKernels<T> const kernels = makeSimdKernels<T>(activeIsa());
+	return kernels;
+}
+
+// Element-parallel loop over n elements compiled for the widest available
+// vectors (see simd::forEachLane); used for struct-of-arrays data
+template<typename T, typename Body>
+void forEachLane(size_t n, Body const &body)
+{
+#if MPCS51044_HAVE_SIMD
+	if constexpr (isSimdType<T>) {
+		switch (activeIsa()) {
+		case Isa::Avx512:
+			return simd::forEachLaneAvx512<T>(n, body);
+		case Isa::Avx2:
+			return simd::forEachLaneAvx2<T>(n, body);
+		case Isa::Sse2:
+			return simd::forEachLaneSse2<T>(n, body);
+		default:
+			break;
+		}
+	}
+#endif
+	for (size_t i = 0; i < n; i++)
+		body(LaneTag<T>{}, i);
+}
+
+}
+#endif
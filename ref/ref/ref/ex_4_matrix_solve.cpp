@@ -0,0 +1,59 @@
+#include "ex_4_dynamic_matrix.h"
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+using namespace mpcs51044_ps;
+using namespace std;
+
+// ex_4_matrix_solve [n]: factor an n x n system once, then solve it over and over
+int main(int argc, char **argv)
+{
+	int const n = argc > 1 ? atoi(argv[1]) : 1000;
+	DynamicMatrix<double> a(n, n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			a(i, j) = (i == j) * n + 1.0 / (i + j + 1);
+	vector<double> b(n, 1.0);
+
+	auto start = chrono::steady_clock::now();
+	auto lu = a.factorize();
+	double const factorSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "LU factorization: " << factorSeconds << " seconds\n";
+
+	int const solves = 1000;
+	vector<double> x;
+	start = chrono::steady_clock::now();
+	for (int k = 0; k < solves; k++) {
+		b[k % n] += 1;
+		x = lu.solve(b);
+	}
+	cout << "LU solve: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() / solves << " seconds each\n";
+
+	// Residual of the last solve
+	double residual = 0;
+	for (int i = 0; i < n; i++) {
+		double r = -b[i];
+		for (int j = 0; j < n; j++)
+			r += a(i, j) * x[j];
+		residual = max(residual, abs(r));
+	}
+	cout << "max |A x - b|: " << residual << '\n';
+
+	// a is symmetric positive definite, so Cholesky works too at half the cost
+	start = chrono::steady_clock::now();
+	auto cholesky = a.cholesky();
+	cout << "Cholesky factorization: " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+
+	// All the right-hand sides at once go through the GEMM kernel
+	DynamicMatrix<double> rhs(n, 256);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < rhs.cols(); j++)
+			rhs(i, j) = i + j;
+	start = chrono::steady_clock::now();
+	DynamicMatrix<double> solutions = cholesky.solveMany(rhs);
+	cout << "Cholesky solve of " << rhs.cols() << " right-hand sides: "
+		<< chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+	cout << "solutions(0, 0): " << solutions(0, 0) << endl;
+}
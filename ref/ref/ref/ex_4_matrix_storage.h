@@ -0,0 +1,159 @@
+#ifndef MATRIX_STORAGE_H
+#  define MATRIX_STORAGE_H
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+using std::array;
+using std::ptrdiff_t;
+using std::size_t;
+using std::unique_ptr;
+
+//////////////////////////////////////////
+// MATRIX STORAGE POLICIES
+//////////////////////////////////////////
+// A Matrix<T, rows, cols> used to own an array<array<T, cols>, rows> member,
+// so a Matrix<double, 1024, 1024> put 8MB on the stack. The storage policy
+// decides where the elements live; every policy is row-major with a leading
+// dimension ld (distance in elements between the starts of consecutive rows),
+// so operator()(x, y) is always data()[x * ld + y] and the kernels just take
+// (pointer, ld).
+//
+//   InlineStorage   elements inside the object (ld == cols). Best for small
+//                   matrices: no allocation, no indirection. The only policy
+//                   usable in constant expressions.
+//   HeapStorage     64-byte (cache line) aligned heap block (ld == cols).
+//                   Moving the matrix just moves the pointer, so a moved-from
+//                   (or released) one holds no elements: it can be assigned
+//                   to, destroyed or copied (the copy is empty too), but not
+//                   read until something is assigned to it.
+//   PaddedStorage   like HeapStorage, but ld is rounded up to whole cache
+//                   lines and bumped by one more line whenever a row would be
+//                   a multiple of 1KB. Walking down a column with a
+//                   power-of-two stride maps every element to the same
+//                   cache set (the "Ghostscript" problem in
+//                   5_cache_conscious_programming.cpp); the extra line spreads
+//                   them across sets.
+//   DefaultStorage  InlineStorage up to 64KB, HeapStorage beyond.
+
+namespace mpcs51044 {
+
+inline constexpr size_t cacheLineSize = 64;
+
+template<typename T>
+struct AlignedDelete {
+	void operator()(T *p) const {
+		::operator delete[](p, std::align_val_t{ cacheLineSize });
+	}
+};
+
+template<typename T>
+using AlignedArray = unique_ptr<T[], AlignedDelete<T>>;
+
+// n value-initialized (i.e. zeroed) elements on a cache line boundary
+template<typename T>
+AlignedArray<T> allocateAligned(size_t n)
+{
+	static_assert(std::is_trivially_destructible_v<T>, "Aligned matrix storage is for arithmetic element types");
+	T *p = static_cast<T *>(::operator new[](std::max<size_t>(n, 1) * sizeof(T), std::align_val_t{ cacheLineSize }));
+	std::uninitialized_value_construct_n(p, n);
+	return AlignedArray<T>(p);
+}
+
+template<typename T, int rows, int cols>
+class InlineStorage {
+public:
+	static constexpr ptrdiff_t ld = cols;
+
+	constexpr T *data() {
+		return elements.data();
+	}
+	constexpr T const *data() const {
+		return elements.data();
+	}
+
+private:
+	array<T, static_cast<size_t>(rows) * cols> elements{};
+};
+
+// Owns rows * ld aligned elements and deep copies them. Empty (no buffer)
+// once moved from or released
+template<typename T, int rows, int cols, ptrdiff_t ld_>
+class AlignedHeapStorage {
+public:
+	static constexpr ptrdiff_t ld = ld_;
+
+	AlignedHeapStorage() : elements(allocateAligned<T>(size)) {}
+	// Takes over a buffer of rows * ld elements allocated by allocateAligned()
+	explicit AlignedHeapStorage(AlignedArray<T> p) : elements(std::move(p)) {}
+	AlignedHeapStorage(AlignedHeapStorage const &other) {
+		if (other.elements) {
+			elements = allocateAligned<T>(size);
+			std::copy(other.data(), other.data() + size, data());
+		}
+	}
+	AlignedHeapStorage &operator=(AlignedHeapStorage const &other) {
+		if (this != &other) {
+			if (!other.elements) {
+				elements.reset();
+				return *this;
+			}
+			if (!elements)
+				elements = allocateAligned<T>(size);
+			std::copy(other.data(), other.data() + size, data());
+		}
+		return *this;
+	}
+	AlignedHeapStorage(AlignedHeapStorage &&) noexcept = default;
+	AlignedHeapStorage &operator=(AlignedHeapStorage &&) noexcept = default;
+
+	T *data() {
+		return elements.get();
+	}
+	T const *data() const {
+		return elements.get();
+	}
+
+	// Hands the buffer over (e.g. to a runtime-sized matrix); leaves this empty
+	AlignedArray<T> release() {
+		return std::move(elements);
+	}
+
+	// Takes over a buffer of rows * ld elements allocated by allocateAligned()
+	void adopt(AlignedArray<T> p) {
+		elements = std::move(p);
+	}
+
+private:
+	static constexpr size_t size = static_cast<size_t>(rows) * ld_;
+	AlignedArray<T> elements;
+};
+
+template<typename T, int rows, int cols>
+using HeapStorage = AlignedHeapStorage<T, rows, cols, cols>;
+
+// Leading dimension for PaddedStorage
+template<typename T>
+constexpr ptrdiff_t paddedLeadingDimension(int cols)
+{
+	constexpr ptrdiff_t perLine = cacheLineSize / sizeof(T) ? cacheLineSize / sizeof(T) : 1;
+	ptrdiff_t ld = (cols + perLine - 1) / perLine * perLine;
+	if (ld * sizeof(T) % 1024 == 0)
+		ld += perLine;
+	return ld;
+}
+
+template<typename T, int rows, int cols>
+using PaddedStorage = AlignedHeapStorage<T, rows, cols, paddedLeadingDimension<T>(cols)>;
+
+template<typename T, int rows, int cols>
+using DefaultStorage = std::conditional_t<
+	sizeof(T) * rows * cols <= 64 * 1024,
+	InlineStorage<T, rows, cols>,
+	HeapStorage<T, rows, cols>>;
+
+}
+#endif
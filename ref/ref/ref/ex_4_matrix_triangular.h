@@ -0,0 +1,172 @@
+#ifndef MATRIX_TRIANGULAR_H
+#  define MATRIX_TRIANGULAR_H
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <numeric>
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_simd.h"
+
+using std::ptrdiff_t;
+using std::size_t;
+
+//////////////////////////////////////////
+// TRIANGULAR SOLVES
+//////////////////////////////////////////
+// Once A is factored (P*A = L*U, or A = L*L^T), solving A*x = b is two
+// triangular solves, O(n^2) instead of the O(n^3) of factoring again.
+//
+// One right-hand side is solved row by row: each x[i] needs a dot product of
+// a row of the factor with the x's already found, or (for L^T, whose rows are
+// columns of L) x[i] is found first and a multiple of row i of L is
+// subtracted from what is left of b. Either way the factor is read along its
+// rows, and forEachLane vectorizes the inner loop.
+//
+// Many right-hand sides (B with nrhs columns) are solved in blocks of NB
+// rows: within a block each row of B is updated with axpys, and the effect of
+// a solved block on all the remaining rows is a single matrix product, done
+// by the same tiled GEMM kernel as the factorizations.
+
+namespace mpcs51044 {
+
+// Which triangle of the row-major n x n factor a to solve with
+enum class Triangle {
+	Lower,            // a's lower triangle, forward substitution
+	Upper,            // a's upper triangle, back substitution
+	LowerTransposed   // the transpose of a's lower triangle, back substitution
+};
+
+// sum of x[i] * y[i], accumulated in vector-wide partial sums
+template<typename T>
+T dotProduct(int n, T const *x, T const *y)
+{
+	// Room for one 512-bit vector of running sums
+	T partial[64 / sizeof(T) ? 64 / sizeof(T) : 1] = {};
+	forEachLane<T>(static_cast<size_t>(n), [&](auto lane, size_t k) {
+		using V = typename decltype(lane)::type;
+		at<V>(partial) += at<V>(x + k) * at<V>(y + k);
+	});
+	return std::accumulate(std::begin(partial), std::end(partial), T{});
+}
+
+// y[0:n) += s * x[0:n)
+template<typename T>
+void axpy(int n, T s, T const *x, T *y)
+{
+	forEachLane<T>(static_cast<size_t>(n), [=](auto lane, size_t k) {
+		using V = typename decltype(lane)::type;
+		at<V>(y + k) += s * at<V>(x + k);
+	});
+}
+
+// Solve op(a) * x = b in place for one right-hand side b[0:n)
+template<typename T>
+void triangularSolve(Triangle triangle, bool unitDiagonal, int n, T const *a, ptrdiff_t lda, T *b)
+{
+	switch (triangle) {
+	case Triangle::Lower:
+		for (int i = 0; i < n; i++) {
+			b[i] -= dotProduct(i, a + i * lda, b);
+			if (!unitDiagonal)
+				b[i] /= a[i * lda + i];
+		}
+		break;
+	case Triangle::Upper:
+		for (int i = n - 1; i >= 0; i--) {
+			b[i] -= dotProduct(n - 1 - i, a + i * lda + i + 1, b + i + 1);
+			if (!unitDiagonal)
+				b[i] /= a[i * lda + i];
+		}
+		break;
+	case Triangle::LowerTransposed:
+		for (int i = n - 1; i >= 0; i--) {
+			if (!unitDiagonal)
+				b[i] /= a[i * lda + i];
+			axpy(i, -b[i], a + i * lda, b);
+		}
+		break;
+	}
+}
+
+// Solve op(a) * X = B in place for the nrhs columns of the row-major n x nrhs B
+template<typename T>
+void triangularSolve(Triangle triangle, bool unitDiagonal, int n, T const *a, ptrdiff_t lda, int nrhs, T *b, ptrdiff_t ldb)
+{
+	constexpr int NB = 32;
+	auto row = [=](int i) { return b + i * ldb; };
+	auto divideRow = [=](int i, T d) {
+		if (!unitDiagonal) {
+			forEachLane<T>(static_cast<size_t>(nrhs), [=](auto lane, size_t k) {
+				using V = typename decltype(lane)::type;
+				at<V>(row(i) + k) /= d;
+			});
+		}
+	};
+	if (triangle == Triangle::Lower) {
+		for (int k0 = 0; k0 < n; k0 += NB) {
+			int const kEnd = std::min(k0 + NB, n);
+			for (int i = k0; i < kEnd; i++) {
+				for (int p = k0; p < i; p++)
+					axpy(nrhs, -a[i * lda + p], row(p), row(i));
+				divideRow(i, a[i * lda + i]);
+			}
+			// B[kEnd:n) -= L[kEnd:n, k0:kEnd) * X[k0:kEnd)
+			if (kEnd < n)
+				dispatchGemm<T>(n - kEnd, nrhs, kEnd - k0,
+					ScaledOperand<T, StridedOperand<T>>{ T{ -1 }, rowMajor(a + kEnd * lda + k0, lda) },
+					rowMajor<T>(row(k0), ldb), row(kEnd), ldb);
+		}
+	} else {
+		// u(i, j) is element (i, j) of the upper triangular factor
+		StridedOperand<T> const u = triangle == Triangle::Upper
+			? StridedOperand<T>{ a, lda, 1 } : StridedOperand<T>{ a, 1, lda };
+		for (int kEnd = n; kEnd > 0;) {
+			int const k0 = std::max(kEnd - NB, 0);
+			// B[k0:kEnd) -= U[k0:kEnd, kEnd:n) * X[kEnd:n)
+			if (kEnd < n)
+				dispatchGemm<T>(kEnd - k0, nrhs, n - kEnd,
+					ScaledOperand<T, StridedOperand<T>>{ T{ -1 }, { u.p + k0 * u.rs + kEnd * u.cs, u.rs, u.cs } },
+					rowMajor<T>(row(kEnd), ldb), row(k0), ldb);
+			for (int i = kEnd - 1; i >= k0; i--) {
+				for (int p = i + 1; p < kEnd; p++)
+					axpy(nrhs, -u(i, p), row(p), row(i));
+				divideRow(i, u(i, i));
+			}
+			kEnd = k0;
+		}
+	}
+}
+
+// Shape of a matrix used as a block of right-hand sides: Matrix has nrows,
+// ncols and ld as constants, DynamicMatrix has rows(), cols() and ld()
+template<typename M>
+int rowsOf(M const &m)
+{
+	if constexpr (requires { m.rows(); })
+		return m.rows();
+	else
+		return M::nrows;
+}
+
+template<typename M>
+int colsOf(M const &m)
+{
+	if constexpr (requires { m.cols(); })
+		return m.cols();
+	else
+		return M::ncols;
+}
+
+template<typename M>
+ptrdiff_t ldOf(M const &m)
+{
+	if constexpr (requires { m.ld(); })
+		return m.ld();
+	else if constexpr (requires { M::ld; })
+		return M::ld;
+	else
+		return colsOf(m);
+}
+
+}
+#endif
@@ -9,6 +9,11 @@
 #include <sstream>
 #include <iomanip>
 #include <concepts>
+#include <functional>
+#include "ex_4_matrix_gemm.h"
+#include "ex_4_matrix_lu.h"
+#include "ex_4_matrix_cholesky.h"
+#include "ex_4_matrix_format.h"
 
 #undef minor
 using std::initializer_list;
@@ -29,39 +34,41 @@ namespace mpcs51044_overload {
 template<floating_point T, int rows, int cols = rows>
 class Matrix {
 public:
+	static constexpr int nrows = rows;
+	static constexpr int ncols = cols;
+
 	Matrix() : data{} {}
 
 	// initializer_list constructor
 	Matrix(initializer_list<initializer_list<T>> init) {
 		auto dp = data.begin();
 		for (auto row : init) {
-			std::copy(row.begin(), row.end(), dp->begin());
-			dp++;
+			std::copy(row.begin(), row.end(), dp);
+			dp += cols;
 		}
 	}
 
 	T &operator()(int x, int y) {
-		return data[x][y];
+		return data[x * cols + y];
 	}
 
 	T operator()(int x, int y) const {
-		return data[x][y];
+		return data[x * cols + y];
+	}
+
+	// Row-major element storage, for the kernels
+	T *storage() {
+		return data.data();
+	}
+	T const *storage() const {
+		return data.data();
 	}
 
 	inline friend
 		ostream &
 		operator<<
 		(ostream &os, const Matrix<T, rows, cols> &m) {
-		size_t width = m.longestElementSize() + 2;
-		os << "[ " << endl;
-		for (int i = 0; i < rows; i++) {
-			for (int j = 0; j < cols; j++) {
-				os << setw(static_cast<streamsize>(width)) << m(i, j);
-			}
-			os << endl;
-		}
-		os << "]" << endl;
-		return os;
+		return mpcs51044::formatMatrix(os, m, rows, cols);
 	}
 
 	Matrix<T, rows - 1, cols - 1> minor(int r, int c) const {
@@ -74,43 +81,42 @@ public:
 				if (j == c) {
 					continue;
 				}
-				result(i < r ? i : i - 1, j < c ? j : j - 1) = data[i][j];
+				result(i < r ? i : i - 1, j < c ? j : j - 1) = (*this)(i, j);
 			}
 		}
 		return result;
 	}
 
+	// P*A = L*U, reusable for several determinants/solves of the same matrix
+	mpcs51044::LUDecomposition<T, rows> factorize() const {
+		static_assert(rows == cols, "Only square matrices can be factored");
+		return { storage(), cols };
+	}
+
+	// A = L*L^T, for symmetric positive definite matrices
+	mpcs51044::CholeskyDecomposition<T, rows> cholesky() const {
+		static_assert(rows == cols, "Only square matrices can be factored");
+		return { storage(), cols };
+	}
+
 	// Defer the definition until further below to avoid
 	// problems with forward references
 	T determinant() const;
 
 private:
-	static size_t accumulateMax(size_t acc, T d) {
-		ostringstream ostr;
-		ostr << d;
-		return std::max(acc, ostr.str().size());
-	}
-	static size_t accumulateMaxRow(size_t acc, array<T, cols> row) {
-		return std::max(acc, accumulate(row.begin(), row.end(), static_cast<size_t>(0), accumulateMax));
-	}
-	size_t longestElementSize() const {
-		return accumulate(data.begin(), data.end(), 0, accumulateMaxRow);
-	}
-	array<array<T, cols>, rows> data;
+	// One flat row-major array rather than an array of rows, so that
+	// storage() can walk all of it
+	array<T, rows * cols> data;
 };
 
 //////////////////////////////////
-// FUNCTION TEMPLATE OVERLOADING: the base method
+// FUNCTION TEMPLATE OVERLOADING: the base method (O(n^3) through the LU factors)
 //////////////////////////////////
 template<floating_point T, int h, int w>
 T
 determinantImpl(const Matrix<T, h, w> &m)
 {
-	T val = 0;
-	for (int i = 0; i < h; i++) {
-		val = (i % 2 ? -1 : 1) * m(i, 0) * m.minor(i, 0).determinant();
-	}
-	return val;
+	return m.factorize().determinant();
 }
 
 //////////////////////////////////
@@ -123,6 +129,25 @@ determinantImpl(const Matrix<T, 1, 1> &m)
 	return m(0, 0);
 }
 
+//////////////////////////////////
+// FUNCTION TEMPLATE OVERLOADING: closed forms for Matrix<T, 2, 2> and Matrix<T, 3, 3>
+//////////////////////////////////
+template<floating_point T>
+T
+determinantImpl(const Matrix<T, 2, 2> &m)
+{
+	return m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+}
+
+template<floating_point T>
+T
+determinantImpl(const Matrix<T, 3, 3> &m)
+{
+	return m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1))
+		- m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0))
+		+ m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+}
+
 // returns the determinant
 template<floating_point T, int h, int w>
 T
@@ -135,14 +160,19 @@ inline Matrix<T, a, c>
 operator*(Matrix<T, a, b> const &l, Matrix<T, b, c> const &r)
 {
 	Matrix<T, a, c> result;
-	for (int i = 0; i < a; i++) {
-		for (int j = 0; j < c; j++) {
-			T total = 0;
-			for (int k = 0; k < b; k++)
-				total += l(i, k) * r(k, j);
-			result(i, j) = total;
-		}
-	}
+	mpcs51044::multiplyInto<T, a, b, c>(
+		mpcs51044::rowMajor(l.storage(), b),
+		mpcs51044::rowMajor(r.storage(), c),
+		result.storage(), c);
+	return result;
+}
+
+template<floating_point T, int h, int w>
+inline Matrix<T, h, w>
+operator+(Matrix<T, h, w> const &l, Matrix<T, h, w> const &r)
+{
+	Matrix<T, h, w> result;
+	std::transform(l.storage(), l.storage() + h * w, r.storage(), result.storage(), std::plus<T>());
 	return result;
 }
 }
@@ -0,0 +1,54 @@
+#include "ex_4_sparse_matrix.h"
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <random>
+using namespace mpcs51044_ps;
+using namespace std;
+
+int main()
+{
+	Matrix<double, 4, 4> small = {
+			{ 1, 0, 0, 2, },
+			{ 0, 0, 3, 0, },
+			{ 0, 0, 0, 0, },
+			{ 4, 0, 5, 0, }
+	};
+	CsrMatrix<double> csr(small);
+	CscMatrix<double> csc({ 4, 4, { { 3, 2, 5 }, { 0, 0, 1 }, { 1, 2, 3 }, { 0, 3, 2 }, { 3, 0, 4 } } });
+	cout << csr << csc << csr.nonZeros() << " nonzeros\n";
+
+	// A 99% zero 2000x2000 matrix times a vector, dense and sparse
+	constexpr int n = 2000;
+	auto dense = make_unique<Matrix<double, n, n>>();
+	auto x = make_unique<Matrix<double, n, 1>>();
+	mt19937 gen(51044);
+	uniform_int_distribution<int> column(0, n - 1);
+	uniform_real_distribution<double> value(-1, 1);
+	for (int i = 0; i < n; i++) {
+		for (int k = 0; k < n / 100; k++)
+			(*dense)(i, column(gen)) = value(gen);
+		(*x)(i, 0) = value(gen);
+	}
+	CsrMatrix<double> a(*dense);
+	CscMatrix<double> aColumns(a);
+
+	auto start = chrono::steady_clock::now();
+	auto yDense = make_unique<Matrix<double, n, 1>>();
+	for (int r = 0; r < 100; r++)
+		*yDense = *dense * *x;
+	cout << "dense:  " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+
+	start = chrono::steady_clock::now();
+	auto ySparse = make_unique<Matrix<double, n, 1>>();
+	for (int r = 0; r < 100; r++)
+		a.multiply(*x, *ySparse);
+	cout << "CSR:    " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " seconds\n";
+
+	auto yColumns = make_unique<Matrix<double, n, 1>>();
+	aColumns.multiply(*x, *yColumns);
+	double diff = 0;
+	for (int i = 0; i < n; i++)
+		diff = max({ diff, abs((*yDense)(i, 0) - (*ySparse)(i, 0)), abs((*yDense)(i, 0) - (*yColumns)(i, 0)) });
+	cout << "max difference: " << diff << endl;
+}
@@ -0,0 +1,346 @@
+#ifndef SPARSE_MATRIX_H
+#  define SPARSE_MATRIX_H
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ex_4_PSMatrix.h"
+#include "ex_4_matrix_simd.h"
+#include "ex_7_thread_pool.h"
+
+using std::ptrdiff_t;
+using std::size_t;
+using std::vector;
+
+//////////////////////////////////////////
+// SPARSE MATRICES (CSR / CSC)
+//////////////////////////////////////////
+// When nearly every element is zero, a dense Matrix spends nearly all of its
+// memory and time on zeros. A compressed matrix keeps only the nonzeros,
+// grouped by row (CSR, "compressed sparse row") or by column (CSC):
+//
+//   values[k], indices[k]   the k-th nonzero and its column (CSR) / row (CSC)
+//   offsets[i]              where row (column) i starts in values/indices;
+//                           offsets[major] == number of nonzeros
+//
+// Unlike Matrix, the size is a runtime value. Element access and printing
+// follow MatrixCommon: m(x, y) reads an element (zero if it isn't stored) and
+// operator<< prints the dense layout. The sparsity pattern is fixed once the
+// matrix is built; values() can still change the stored elements.
+//
+// Products (SpMV: y = A * x, SpMM: C = A * B with B dense) are split across
+// the thread pool by nonzero count rather than by row count, so one dense row
+// doesn't leave the other threads waiting. Within a row:
+//   CSR  y[i] is a dot product of the row with x gathered through indices,
+//        accumulated in vector-wide partial sums via forEachLane
+//   SpMM each nonzero adds a multiple of a dense row of B to a row of C, a
+//        contiguous axpy that forEachLane vectorizes
+//   CSC  a column scatters into y, so each thread scatters into a buffer of
+//        its own and the buffers are summed at the end
+
+namespace mpcs51044_ps {
+
+enum class SparseLayout { Csr, Csc };
+
+// One element of a sparse matrix under construction
+template<typename T>
+struct Triplet {
+	int row;
+	int col;
+	T value;
+};
+
+template<typename T, SparseLayout layout = SparseLayout::Csr>
+class SparseMatrix {
+public:
+	using value_type = T;
+	static constexpr bool rowMajor = layout == SparseLayout::Csr;
+
+	// rows x cols, all zero
+	SparseMatrix(int rows, int cols) : nr(rows), nc(cols), starts(static_cast<size_t>(major()) + 1) {}
+
+	// Duplicate (row, col) entries are added together; zeros are dropped
+	SparseMatrix(int rows, int cols, vector<Triplet<T>> triplets) : nr(rows), nc(cols) {
+		for (auto const &t : triplets) {
+			if (t.row < 0 || t.row >= rows || t.col < 0 || t.col >= cols)
+				throw std::out_of_range("Triplet outside the sparse matrix");
+		}
+		std::sort(triplets.begin(), triplets.end(), [](Triplet<T> const &a, Triplet<T> const &b) {
+			return std::pair(majorOf(a), minorOf(a)) < std::pair(majorOf(b), minorOf(b));
+		});
+		starts.assign(static_cast<size_t>(major()) + 1, 0);
+		for (size_t k = 0; k < triplets.size();) {
+			Triplet<T> const &t = triplets[k];
+			T sum{};
+			for (; k < triplets.size() && majorOf(triplets[k]) == majorOf(t) && minorOf(triplets[k]) == minorOf(t); k++)
+				sum += triplets[k].value;
+			if (sum != T{}) {
+				idx.push_back(minorOf(t));
+				vals.push_back(sum);
+				starts[majorOf(t) + 1]++;
+			}
+		}
+		std::partial_sum(starts.begin(), starts.end(), starts.begin());
+	}
+
+	// The nonzeros of a dense Matrix
+	template<int rows, int cols, template<typename, int, int> class S>
+	explicit SparseMatrix(Matrix<T, rows, cols, S> const &m) : nr(rows), nc(cols), starts(static_cast<size_t>(major()) + 1) {
+		for (int i = 0; i < major(); i++) {
+			for (int j = 0; j < minor(); j++) {
+				T const v = rowMajor ? m(i, j) : m(j, i);
+				if (v != T{}) {
+					idx.push_back(j);
+					vals.push_back(v);
+				}
+			}
+			starts[i + 1] = static_cast<ptrdiff_t>(vals.size());
+		}
+	}
+
+	// The same matrix in the other layout (a counting sort of the nonzeros)
+	template<SparseLayout other>
+	explicit SparseMatrix(SparseMatrix<T, other> const &m)
+		: nr(m.rows()), nc(m.cols()), starts(static_cast<size_t>(major()) + 1), idx(m.nonZeros()), vals(m.nonZeros()) {
+		if constexpr (other == layout) {
+			starts = m.offsets();
+			idx = m.indices();
+			vals = m.values();
+		} else {
+			for (int i : m.indices())
+				starts[i + 1]++;
+			std::partial_sum(starts.begin(), starts.end(), starts.begin());
+			vector<ptrdiff_t> next(starts.begin(), starts.end() - 1);
+			for (int j = 0; j < minor(); j++) {
+				for (ptrdiff_t k = m.offsets()[j]; k < m.offsets()[j + 1]; k++) {
+					ptrdiff_t const dst = next[m.indices()[k]]++;
+					idx[dst] = j;
+					vals[dst] = m.values()[k];
+				}
+			}
+		}
+	}
+
+	int rows() const {
+		return nr;
+	}
+	int cols() const {
+		return nc;
+	}
+	size_t nonZeros() const {
+		return vals.size();
+	}
+
+	// Element (x, y), or zero if it isn't stored. A binary search of one row
+	// (column), so prefer the products below to loops over m(x, y).
+	T operator()(int x, int y) const {
+		int const i = rowMajor ? x : y;
+		int const j = rowMajor ? y : x;
+		auto const first = idx.begin() + starts[i];
+		auto const last = idx.begin() + starts[i + 1];
+		auto const it = std::lower_bound(first, last, j);
+		return it != last && *it == j ? vals[it - idx.begin()] : T{};
+	}
+
+	// Compressed storage, for kernels (see the comment at the top)
+	vector<ptrdiff_t> const &offsets() const {
+		return starts;
+	}
+	vector<int> const &indices() const {
+		return idx;
+	}
+	vector<T> const &values() const {
+		return vals;
+	}
+	vector<T> &values() {
+		return vals;
+	}
+
+	// Transposing just reinterprets CSR as CSC and vice versa
+	auto transpose() const {
+		constexpr SparseLayout other = rowMajor ? SparseLayout::Csc : SparseLayout::Csr;
+		SparseMatrix<T, other> result(nc, nr);
+		result.starts = starts;
+		result.idx = idx;
+		result.vals = vals;
+		return result;
+	}
+
+	template<int rows, int cols, template<typename, int, int> class S = DefaultStorage>
+	Matrix<T, rows, cols, S> toDense() const {
+		checkSize(rows, cols);
+		Matrix<T, rows, cols, S> result;
+		for (int i = 0; i < major(); i++) {
+			for (ptrdiff_t k = starts[i]; k < starts[i + 1]; k++) {
+				if (rowMajor)
+					result(i, idx[k]) = vals[k];
+				else
+					result(idx[k], i) = vals[k];
+			}
+		}
+		return result;
+	}
+
+	// SpMV: y (rows()) = A * x (cols())
+	void multiply(T const *x, T *y, mpcs51044::thread_pool &pool = mpcs51044::thread_pool::instance()) const {
+		multiply(1, x, 1, y, 1, pool);
+	}
+
+	// SpMM: C (rows() x n, leading dimension ldc) = A * B (cols() x n, leading dimension ldb)
+	void multiply(int n, T const *b, ptrdiff_t ldb, T *c, ptrdiff_t ldc,
+		mpcs51044::thread_pool &pool = mpcs51044::thread_pool::instance()) const {
+		if constexpr (rowMajor) {
+			forEachBlock(pool, [&](int i0, int i1) {
+				for (int i = i0; i < i1; i++)
+					rowTimesDense(i, n, b, ldb, c + i * ldc);
+			});
+		} else {
+			scatterColumns(n, b, ldb, c, ldc, pool);
+		}
+	}
+
+	vector<T> operator*(vector<T> const &x) const {
+		if (static_cast<int>(x.size()) != nc)
+			throw std::invalid_argument("Sparse matrix and vector sizes must match");
+		vector<T> y(nr);
+		multiply(x.data(), y.data());
+		return y;
+	}
+
+	// C = A * B for dense Matrix operands
+	template<int b, int c, int a, template<typename, int, int> class S1, template<typename, int, int> class S2>
+	void multiply(Matrix<T, b, c, S1> const &B, Matrix<T, a, c, S2> &C,
+		mpcs51044::thread_pool &pool = mpcs51044::thread_pool::instance()) const {
+		checkSize(a, b);
+		multiply(c, B.storage(), B.ld, C.storage(), C.ld, pool);
+	}
+
+	inline friend
+		ostream &
+		operator<<
+		(ostream &os, const SparseMatrix &m) {
+		return printMatrix(os, m, m.rows(), m.cols());
+	}
+
+private:
+	template<typename, SparseLayout> friend class SparseMatrix;
+
+	int major() const {
+		return rowMajor ? nr : nc;
+	}
+	int minor() const {
+		return rowMajor ? nc : nr;
+	}
+	static int majorOf(Triplet<T> const &t) {
+		return rowMajor ? t.row : t.col;
+	}
+	static int minorOf(Triplet<T> const &t) {
+		return rowMajor ? t.col : t.row;
+	}
+
+	void checkSize(int rows, int cols) const {
+		if (rows != nr || cols != nc)
+			throw std::invalid_argument("Sparse and dense Matrix dimensions must match");
+	}
+
+	// Calls f(first, last) on ranges of rows (columns) with about the same
+	// number of nonzeros in each. A row belongs to the block its first
+	// nonzero falls in.
+	template<typename F>
+	void forEachBlock(mpcs51044::thread_pool &pool, F const &f) const {
+		ptrdiff_t const nnz = static_cast<ptrdiff_t>(vals.size());
+		mpcs51044::parallel_for<ptrdiff_t>(0, std::max<ptrdiff_t>(nnz, 1), minPerThread, [&](ptrdiff_t k0, ptrdiff_t k1) {
+			f(blockStart(k0), k1 >= nnz ? major() : blockStart(k1));
+		}, pool);
+	}
+	int blockStart(ptrdiff_t k) const {
+		return k == 0 ? 0 : static_cast<int>(std::lower_bound(starts.begin(), starts.end() - 1, k) - starts.begin());
+	}
+
+	// out[0:n) = row i of A times B
+	void rowTimesDense(int i, int n, T const *b, ptrdiff_t ldb, T *out) const {
+		ptrdiff_t const first = starts[i];
+		ptrdiff_t const last = starts[i + 1];
+		if (n == 1) {
+			out[0] = sparseDot(static_cast<size_t>(last - first), vals.data() + first, idx.data() + first, b, ldb);
+			return;
+		}
+		std::fill(out, out + n, T{});
+		for (ptrdiff_t k = first; k < last; k++)
+			axpy(n, vals[k], b + idx[k] * ldb, out);
+	}
+
+	// Each block of columns scatters into a buffer of its own; then the
+	// buffers are summed row by row
+	void scatterColumns(int n, T const *b, ptrdiff_t ldb, T *c, ptrdiff_t ldc, mpcs51044::thread_pool &pool) const {
+		ptrdiff_t const nnz = static_cast<ptrdiff_t>(vals.size());
+		int const blocks = static_cast<int>(std::clamp<ptrdiff_t>(nnz / minPerThread, 1, pool.size() + 1));
+		vector<vector<T>> partial(blocks);
+		mpcs51044::parallel_for(0, blocks, 1, [&](int b0, int b1) {
+			for (int blk = b0; blk < b1; blk++) {
+				vector<T> &out = partial[blk];
+				out.assign(static_cast<size_t>(nr) * n, T{});
+				int const j0 = blockStart(nnz * blk / blocks);
+				int const j1 = blk + 1 == blocks ? nc : blockStart(nnz * (blk + 1) / blocks);
+				for (int j = j0; j < j1; j++) {
+					for (ptrdiff_t k = starts[j]; k < starts[j + 1]; k++)
+						axpy(n, vals[k], b + j * ldb, out.data() + static_cast<ptrdiff_t>(idx[k]) * n);
+				}
+			}
+		}, pool);
+		mpcs51044::parallel_for(0, nr, std::max(1, static_cast<int>(minPerThread / std::max(n * blocks, 1))), [&](int i0, int i1) {
+			for (int i = i0; i < i1; i++) {
+				T *out = c + i * ldc;
+				std::copy(partial[0].data() + static_cast<ptrdiff_t>(i) * n, partial[0].data() + static_cast<ptrdiff_t>(i + 1) * n, out);
+				for (int blk = 1; blk < blocks; blk++)
+					axpy(n, T{ 1 }, partial[blk].data() + static_cast<ptrdiff_t>(i) * n, out);
+			}
+		}, pool);
+	}
+
+	// out[0:n) += s * x[0:n)
+	static void axpy(int n, T s, T const *x, T *out) {
+		mpcs51044::forEachLane<T>(static_cast<size_t>(n), [=](auto lane, size_t m) {
+			using V = typename decltype(lane)::type;
+			mpcs51044::at<V>(out + m) += s * mpcs51044::at<V>(x + m);
+		});
+	}
+
+	// sum of v[k] * x[i[k] * incx]
+	static T sparseDot(size_t n, T const *v, int const *i, T const *x, ptrdiff_t incx) {
+		// Room for one 512-bit vector of running sums
+		T partial[64 / sizeof(T) ? 64 / sizeof(T) : 1] = {};
+		mpcs51044::forEachLane<T>(n, [&](auto lane, size_t k) {
+			using V = typename decltype(lane)::type;
+			if constexpr (sizeof(V) == sizeof(T)) {
+				partial[0] += v[k] * x[i[k] * incx];
+			} else {
+				V gathered;
+				for (size_t l = 0; l < sizeof(V) / sizeof(T); l++)
+					gathered[l] = x[i[k + l] * incx];
+				mpcs51044::at<V>(partial) += mpcs51044::at<V>(v + k) * gathered;
+			}
+		});
+		return std::accumulate(std::begin(partial), std::end(partial), T{});
+	}
+
+	// Smallest share of the nonzeros worth handing to another thread
+	static constexpr ptrdiff_t minPerThread = 16 * 1024;
+
+	int nr;
+	int nc;
+	vector<ptrdiff_t> starts;
+	vector<int> idx;
+	vector<T> vals;
+};
+
+template<typename T>
+using CsrMatrix = SparseMatrix<T, SparseLayout::Csr>;
+template<typename T>
+using CscMatrix = SparseMatrix<T, SparseLayout::Csc>;
+
+}
+#endif
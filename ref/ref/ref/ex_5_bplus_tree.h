@@ -0,0 +1,520 @@
+#ifndef BPLUS_TREE_H
+#  define BPLUS_TREE_H
+// Despite the name, btree (ex_5_btree_spertus.h) and Btree (ex_5_btree_austin.h)
+// are binary search trees: one key and two heap pointers per node, a cache
+// miss for every level, and sorted input turns them into linked lists.
+//
+// bplus_tree is a real B+-tree. Every node fills a few cache lines, and its
+// keys sit next to each other, so one node answers as much as log2(fanout)
+// levels of a binary tree would. Inner nodes only route searches, and every
+// key lives in a leaf. All leaves are at the same depth, so insert, search
+// and erase are O(log_B n) whatever order the keys arrive in:
+//   insert  splits full nodes on the way down, so there is always room
+//           for the separator a split pushes into the parent
+//   erase   tops up minimal nodes on the way down (borrowing a key from a
+//           sibling or merging with it), so a leaf can always give one up
+// Both walk down a single path with no recursion and no backtracking.
+//
+// Within a node the position of a key is the number of keys below it,
+// counted four at a time with vector compares instead of a binary search
+// full of unpredictable branches (GCC and Clang vector extensions; other
+// compilers get a plain loop that counts just as branch-free).
+//
+// Leaves and inner nodes come from two node_pools the tree owns, so a split
+// rarely calls malloc and clearing the tree frees them a chunk at a time.
+//
+// bulk_load builds the tree from sorted keys a level at a time, bottom up,
+// in O(n): fill the leaves left to right, then the inner nodes above them,
+// and so on until one node is left. How full it packs the nodes is up to the
+// caller. Full nodes make the smallest, fastest tree to search, but the
+// first insert into each leaf splits it; a fill of 0.7 or so leaves room.
+//
+// freeze() reads the leaves in order into an eytzinger_index, and
+// for_each_in_range() scans them from the first key in the range, touching
+// memory in order.
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define MPCS51044_HAVE_VECTOR_EXT 1
+#else
+#  define MPCS51044_HAVE_VECTOR_EXT 0
+#endif
+#include <vector>
+#include "ex_5_eytzinger.h"
+#include "ex_5_node_pool.h"
+
+namespace mpcs51044 {
+
+class bplus_tree {
+public:
+	using key_type = int;
+	using value_type = int;
+	using key_compare = std::less<int>;
+
+	bplus_tree() = default;
+
+	// Copy construction and assignment deep copy
+	bplus_tree(bplus_tree const &other) : count(other.count)
+	{
+		leaf *previous = nullptr;
+		if (other.root)
+			root = copy(other.root, previous);
+	}
+	bplus_tree &operator=(bplus_tree const &other)
+	{
+		if (&other != this) {
+			bplus_tree copied(other);
+			swap(copied);
+		}
+		return *this;
+	}
+
+	// Move construction and assignment just take over the nodes
+	bplus_tree(bplus_tree &&other) noexcept
+		: leaves(std::move(other.leaves)), inners(std::move(other.inners)),
+		  root(std::exchange(other.root, nullptr)), count(std::exchange(other.count, 0)) {}
+	bplus_tree &operator=(bplus_tree &&other) noexcept
+	{
+		swap(other);
+		return *this;
+	}
+
+	void swap(bplus_tree &other) noexcept
+	{
+		leaves.swap(other.leaves);
+		inners.swap(other.inners);
+		std::swap(root, other.root);
+		std::swap(count, other.count);
+	}
+
+	// Returns false (and changes nothing) if key was already there
+	bool insert(int key);
+	bool search(int key) const;
+	// Returns false if key wasn't there
+	bool erase(int key);
+
+	// Replace the contents with the keys in [first, last), which must be
+	// strictly ascending, packing each node to about fill of its capacity
+	// (clamped to [0.5, 1]). Throws invalid_argument (leaving the tree as it
+	// was) if the keys aren't ascending
+	template<std::forward_iterator Iter>
+	void bulk_load(Iter first, Iter last, double fill = 1.0);
+
+	// Call f on each key in [lo, hi), in order: find lo's leaf, then read
+	// along the chain of leaves
+	template<typename F>
+	void for_each_in_range(int lo, int hi, F &&f) const
+	{
+		node const *n = root;
+		if (!n)
+			return;
+		while (!n->is_leaf) {
+			inner const *in = static_cast<inner const *>(n);
+			n = in->children[child_index(in, lo)];
+		}
+		leaf const *l = static_cast<leaf const *>(n);
+		for (int i = count_below<false>(l->keys, l->n, lo); l; l = l->next, i = 0) {
+			for (; i < l->n; i++) {
+				if (l->keys[i] >= hi)
+					return;
+				f(l->keys[i]);
+			}
+		}
+	}
+
+	// The keys as they are now, searchable without the tree
+	eytzinger_index freeze() const
+	{
+		std::vector<int> keys;
+		keys.reserve(count);
+		node const *n = root;
+		while (n && !n->is_leaf)
+			n = static_cast<inner const *>(n)->children[0];
+		for (leaf const *l = static_cast<leaf const *>(n); l; l = l->next)
+			keys.insert(keys.end(), l->keys, l->keys + l->n);
+		return eytzinger_index(keys.begin(), keys.end());
+	}
+
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	key_compare key_comp() const { return {}; }
+	void clear()
+	{
+		leaves.release();
+		inners.release();
+		root = nullptr;
+		count = 0;
+	}
+
+	// Levels from the root to the leaves (0 if empty)
+	int height() const
+	{
+		int levels = 0;
+		for (node const *n = root; n; n = n->is_leaf ? nullptr : static_cast<inner const *>(n)->children[0])
+			levels++;
+		return levels;
+	}
+
+	// Nodes are node_bytes long and start on a cache line
+	static constexpr std::size_t cache_line = 64;
+	static constexpr std::size_t node_bytes = 4 * cache_line;
+
+private:
+	struct node {
+		bool is_leaf;
+		int n = 0; // keys in use
+	};
+
+	// Capacities are rounded down to whole vectors of keys, so the search
+	// never reads past the end of a key array
+	static constexpr int lanes = 4;
+	static constexpr int leaf_capacity =
+		(node_bytes - sizeof(node) - sizeof(void *)) / sizeof(int) / lanes * lanes;
+	static constexpr int inner_capacity =
+		(node_bytes - sizeof(node) - sizeof(void *)) / (sizeof(int) + sizeof(void *)) / lanes * lanes;
+
+	// keys[0..n) in ascending order, and the leaf with the next larger keys
+	struct alignas(cache_line) leaf : node {
+		leaf() { is_leaf = true; }
+		int keys[leaf_capacity] = {};
+		leaf *next = nullptr;
+	};
+
+	// children[i] holds the keys k with keys[i-1] <= k < keys[i]
+	struct alignas(cache_line) inner : node {
+		inner() { is_leaf = false; }
+		int keys[inner_capacity] = {};
+		node *children[inner_capacity + 1] = {};
+	};
+
+	static_assert(sizeof(leaf) == node_bytes && sizeof(inner) == node_bytes,
+		"A node should fill its cache lines exactly");
+
+	// Number of keys[0..n) below key (or, with or_equal, not above it)
+	template<bool or_equal>
+	static int count_below(int const *keys, int n, int key)
+	{
+#if MPCS51044_HAVE_VECTOR_EXT
+		typedef int lane_vector __attribute__((vector_size(lanes * sizeof(int))));
+		lane_vector const k = { key, key, key, key };
+		lane_vector const lane = { 0, 1, 2, 3 };
+		lane_vector below = {};
+		for (int i = 0; i < n; i += lanes) {
+			lane_vector v;
+			std::memcpy(&v, keys + i, sizeof v);
+			// Compares give -1 for true, so this subtracts the matches;
+			// lanes past n don't count
+			below += (or_equal ? v <= k : v < k) & (lane + i < n);
+		}
+		return -(below[0] + below[1] + below[2] + below[3]);
+#else
+		int below = 0;
+		for (int i = 0; i < n; i++)
+			below += or_equal ? keys[i] <= key : keys[i] < key;
+		return below;
+#endif
+	}
+
+	// Which child of an inner node key belongs in
+	static int child_index(inner const *in, int key) { return count_below<true>(in->keys, in->n, key); }
+
+	// Two inner nodes at the minimum plus the separator between them must
+	// fit in one when they are merged
+	static int min_keys(node const *n) { return n->is_leaf ? leaf_capacity / 2 : (inner_capacity - 1) / 2; }
+	static bool full(node const *n) { return n->n == (n->is_leaf ? leaf_capacity : inner_capacity); }
+
+	void split_child(inner *parent, int i);
+	void top_up_child(inner *parent, int i);
+
+	// previous is the last leaf copied so far, for relinking the leaf chain
+	node *copy(node const *n, leaf *&previous)
+	{
+		if (n->is_leaf) {
+			leaf *copied = leaves.make(*static_cast<leaf const *>(n));
+			copied->next = nullptr;
+			if (previous)
+				previous->next = copied;
+			previous = copied;
+			return copied;
+		}
+		inner const *in = static_cast<inner const *>(n);
+		inner *copied = inners.make(*in);
+		for (int i = 0; i <= in->n; i++)
+			copied->children[i] = copy(in->children[i], previous);
+		return copied;
+	}
+
+	node_pool<leaf> leaves;
+	node_pool<inner> inners;
+	node *root = nullptr;
+	std::size_t count = 0;
+};
+
+template<std::forward_iterator Iter>
+void bplus_tree::bulk_load(Iter first, Iter last, double fill)
+{
+	fill = std::clamp(fill, 0.5, 1.0);
+	std::size_t const n = static_cast<std::size_t>(std::distance(first, last));
+	bplus_tree loaded;
+	if (n == 0) {
+		swap(loaded);
+		return;
+	}
+
+	// Split m things into as few groups of at most per as possible, as
+	// evenly as possible, so (unless there is only one) every group has
+	// more than per / 2. Calls f(group_size) for each group
+	auto groups = [](std::size_t m, std::size_t per, auto f) {
+		std::size_t const count = (m + per - 1) / per;
+		for (std::size_t g = 0; g < count; g++)
+			f(m / count + (g < m % count ? 1 : 0));
+	};
+
+	// Each level is its nodes, and the smallest key under each of them
+	// (which becomes the separator in front of it one level up)
+	std::vector<node *> level;
+	std::vector<int> lowest;
+	std::size_t const per_leaf = static_cast<std::size_t>(std::lround(fill * leaf_capacity));
+	loaded.leaves.reserve((n + per_leaf - 1) / per_leaf);
+	leaf *previous = nullptr;
+	bool first_key = true;
+	int last_key = 0;
+	groups(n, per_leaf, [&](std::size_t size) {
+		leaf *l = loaded.leaves.make();
+		for (std::size_t i = 0; i < size; i++) {
+			int const key = *first++;
+			if (!first_key && !(last_key < key))
+				throw std::invalid_argument("bplus_tree::bulk_load needs strictly ascending keys");
+			first_key = false;
+			last_key = key;
+			l->keys[i] = key;
+		}
+		l->n = static_cast<int>(size);
+		if (previous)
+			previous->next = l;
+		previous = l;
+		level.push_back(l);
+		lowest.push_back(l->keys[0]);
+	});
+
+	// An inner node with fill of its capacity in keys has one more child
+	std::size_t const per_inner = static_cast<std::size_t>(std::lround(fill * inner_capacity)) + 1;
+	while (level.size() > 1) {
+		std::vector<node *> above;
+		std::vector<int> above_lowest;
+		std::size_t next = 0;
+		groups(level.size(), per_inner, [&](std::size_t size) {
+			inner *in = loaded.inners.make();
+			in->children[0] = level[next];
+			for (std::size_t i = 1; i < size; i++) {
+				in->keys[i - 1] = lowest[next + i];
+				in->children[i] = level[next + i];
+			}
+			in->n = static_cast<int>(size - 1);
+			above.push_back(in);
+			above_lowest.push_back(lowest[next]);
+			next += size;
+		});
+		level.swap(above);
+		lowest.swap(above_lowest);
+	}
+	loaded.root = level[0];
+	loaded.count = n;
+	swap(loaded);
+}
+
+inline bool bplus_tree::search(int key) const
+{
+	node const *n = root;
+	if (!n)
+		return false;
+	while (!n->is_leaf) {
+		inner const *in = static_cast<inner const *>(n);
+		n = in->children[child_index(in, key)];
+	}
+	leaf const *l = static_cast<leaf const *>(n);
+	int const i = count_below<false>(l->keys, l->n, key);
+	return i < l->n && l->keys[i] == key;
+}
+
+// Split the full child i of parent in two, adding a separator to parent
+inline void bplus_tree::split_child(inner *parent, int i)
+{
+	node *child = parent->children[i];
+	node *sibling;
+	int separator;
+	if (child->is_leaf) {
+		leaf *l = static_cast<leaf *>(child);
+		leaf *right = leaves.make();
+		int const keep = l->n / 2;
+		right->n = l->n - keep;
+		std::copy(l->keys + keep, l->keys + l->n, right->keys);
+		l->n = keep;
+		right->next = l->next;
+		l->next = right;
+		// B+-tree: the separator is a copy, the key itself stays in the leaf
+		separator = right->keys[0];
+		sibling = right;
+	} else {
+		inner *in = static_cast<inner *>(child);
+		inner *right = inners.make();
+		int const keep = in->n / 2;
+		// The middle key moves up to the parent
+		separator = in->keys[keep];
+		right->n = in->n - keep - 1;
+		std::copy(in->keys + keep + 1, in->keys + in->n, right->keys);
+		std::copy(in->children + keep + 1, in->children + in->n + 1, right->children);
+		in->n = keep;
+		sibling = right;
+	}
+	std::copy_backward(parent->keys + i, parent->keys + parent->n, parent->keys + parent->n + 1);
+	std::copy_backward(parent->children + i + 1, parent->children + parent->n + 1, parent->children + parent->n + 2);
+	parent->keys[i] = separator;
+	parent->children[i + 1] = sibling;
+	parent->n++;
+}
+
+inline bool bplus_tree::insert(int key)
+{
+	if (!root)
+		root = leaves.make();
+	if (full(root)) {
+		inner *new_root = inners.make();
+		new_root->children[0] = root;
+		root = new_root;
+		split_child(new_root, 0);
+	}
+	node *n = root;
+	while (!n->is_leaf) {
+		inner *in = static_cast<inner *>(n);
+		int i = child_index(in, key);
+		if (full(in->children[i])) {
+			split_child(in, i);
+			if (key >= in->keys[i])
+				i++;
+		}
+		n = in->children[i];
+	}
+	leaf *l = static_cast<leaf *>(n);
+	int const i = count_below<false>(l->keys, l->n, key);
+	if (i < l->n && l->keys[i] == key)
+		return false;
+	std::copy_backward(l->keys + i, l->keys + l->n, l->keys + l->n + 1);
+	l->keys[i] = key;
+	l->n++;
+	count++;
+	return true;
+}
+
+// Make sure child i of parent has more than the minimum number of keys, so
+// one can be erased below it: borrow one from a sibling that can spare it,
+// or else merge with a sibling
+inline void bplus_tree::top_up_child(inner *parent, int i)
+{
+	node *child = parent->children[i];
+	node *left = i > 0 ? parent->children[i - 1] : nullptr;
+	node *right = i < parent->n ? parent->children[i + 1] : nullptr;
+	if (left && left->n > min_keys(left)) {
+		if (child->is_leaf) {
+			leaf *c = static_cast<leaf *>(child), *l = static_cast<leaf *>(left);
+			std::copy_backward(c->keys, c->keys + c->n, c->keys + c->n + 1);
+			c->keys[0] = l->keys[--l->n];
+			parent->keys[i - 1] = c->keys[0];
+		} else {
+			inner *c = static_cast<inner *>(child), *l = static_cast<inner *>(left);
+			std::copy_backward(c->keys, c->keys + c->n, c->keys + c->n + 1);
+			std::copy_backward(c->children, c->children + c->n + 1, c->children + c->n + 2);
+			c->keys[0] = parent->keys[i - 1];
+			c->children[0] = l->children[l->n];
+			parent->keys[i - 1] = l->keys[--l->n];
+		}
+		child->n++;
+		return;
+	}
+	if (right && right->n > min_keys(right)) {
+		if (child->is_leaf) {
+			leaf *c = static_cast<leaf *>(child), *r = static_cast<leaf *>(right);
+			c->keys[c->n] = r->keys[0];
+			std::copy(r->keys + 1, r->keys + r->n, r->keys);
+			parent->keys[i] = r->keys[0];
+		} else {
+			inner *c = static_cast<inner *>(child), *r = static_cast<inner *>(right);
+			c->keys[c->n] = parent->keys[i];
+			c->children[c->n + 1] = r->children[0];
+			parent->keys[i] = r->keys[0];
+			std::copy(r->keys + 1, r->keys + r->n, r->keys);
+			std::copy(r->children + 1, r->children + r->n + 1, r->children);
+		}
+		right->n--;
+		child->n++;
+		return;
+	}
+
+	// Neither sibling can spare a key: merge child with one of them. The
+	// right node of the pair (and the separator between them) goes away.
+	int const j = left ? i - 1 : i;
+	node *a = parent->children[j];
+	node *b = parent->children[j + 1];
+	if (a->is_leaf) {
+		leaf *la = static_cast<leaf *>(a), *lb = static_cast<leaf *>(b);
+		std::copy(lb->keys, lb->keys + lb->n, la->keys + la->n);
+		la->n += lb->n;
+		la->next = lb->next;
+		leaves.destroy(lb);
+	} else {
+		inner *ia = static_cast<inner *>(a), *ib = static_cast<inner *>(b);
+		ia->keys[ia->n] = parent->keys[j];
+		std::copy(ib->keys, ib->keys + ib->n, ia->keys + ia->n + 1);
+		std::copy(ib->children, ib->children + ib->n + 1, ia->children + ia->n + 1);
+		ia->n += ib->n + 1;
+		inners.destroy(ib);
+	}
+	std::copy(parent->keys + j + 1, parent->keys + parent->n, parent->keys + j);
+	std::copy(parent->children + j + 2, parent->children + parent->n + 1, parent->children + j + 1);
+	parent->n--;
+}
+
+inline bool bplus_tree::erase(int key)
+{
+	if (!root)
+		return false;
+	node *n = root;
+	while (!n->is_leaf) {
+		inner *in = static_cast<inner *>(n);
+		int i = child_index(in, key);
+		if (in->children[i]->n <= min_keys(in->children[i])) {
+			top_up_child(in, i);
+			// A merge may have removed the root's last key
+			if (in == root && in->n == 0) {
+				root = in->children[0];
+				inners.destroy(in);
+				n = root;
+				continue;
+			}
+			i = child_index(in, key);
+		}
+		n = in->children[i];
+	}
+	leaf *l = static_cast<leaf *>(n);
+	int const i = count_below<false>(l->keys, l->n, key);
+	if (i == l->n || l->keys[i] != key)
+		return false;
+	std::copy(l->keys + i + 1, l->keys + l->n, l->keys + i);
+	l->n--;
+	count--;
+	if (count == 0) {
+		leaves.destroy(static_cast<leaf *>(root));
+		root = nullptr;
+	}
+	return true;
+}
+
+}
+#endif
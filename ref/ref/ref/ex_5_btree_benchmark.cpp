@@ -0,0 +1,222 @@
+#include "ex_5_bplus_tree.h"
+#include "ex_5_btree_austin.h"
+#include "ex_5_btree_spertus.h"
+#include "ex_5_bulk_load.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+using namespace std;
+
+//////////////////////////////////////////
+// TREE BENCHMARKS
+//////////////////////////////////////////
+// ex_5_btree_benchmark [n]
+//
+// Inserts n distinct keys (default 1000000) into bplus_tree and the two
+// binary search trees, looks each one up again along with n keys that
+// aren't there, and (for the two that can) erases them all, printing
+// nanoseconds per operation. It does that twice: with the keys in random
+// order, and with them sorted, which is where the unbalanced Btree degrades
+// into a list. It is recursive, so on sorted keys it only gets n / 100 keys
+// (its time per operation is already O(n) there).
+//
+// Last, it times building btree and bplus_tree from the n sorted keys with
+// bulk_load, and from the shuffled keys with parallel_bulk_load, against
+// inserting them one at a time.
+//
+// Then it freezes each of the two into an eytzinger_index and times hits and
+// misses there, next to a binary search of the sorted keys.
+//
+// Finally it times for_each_in_range over random ranges of 1000 keys in
+// btree and bplus_tree, in nanoseconds per key visited.
+
+// Keep the compiler from discarding a result it can see is never used
+template<typename T>
+inline void doNotOptimize(T const &value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+template<typename F>
+double nsPerOp(size_t ops, F f)
+{
+	auto const start = chrono::steady_clock::now();
+	f();
+	chrono::duration<double, nano> const elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count() / ops;
+}
+
+// Search results are only tested for truth, so Btree's Node* works too
+template<typename Tree>
+void run(char const *name, vector<int> const &keys, vector<int> const &missing)
+{
+	Tree tree;
+	double const insert = nsPerOp(keys.size(), [&] {
+		for (int k : keys)
+			tree.insert(k);
+	});
+	size_t found = 0;
+	double const hit = nsPerOp(keys.size(), [&] {
+		for (int k : keys)
+			found += tree.search(k) ? 1 : 0;
+	});
+	double const miss = nsPerOp(missing.size(), [&] {
+		for (int k : missing)
+			found += tree.search(k) ? 1 : 0;
+	});
+	doNotOptimize(found);
+	if (found != keys.size()) {
+		cerr << name << " found " << found << " of " << keys.size() << " keys\n";
+		exit(1);
+	}
+	cout << setw(12) << name << setw(10) << keys.size()
+		<< setw(10) << insert << setw(10) << hit << setw(10) << miss;
+	if constexpr (requires { tree.erase(0); }) {
+		double const erase = nsPerOp(keys.size(), [&] {
+			for (int k : keys)
+				tree.erase(k);
+		});
+		cout << setw(10) << erase;
+		if (!tree.empty()) {
+			cerr << name << " has " << tree.size() << " keys left after erasing them all\n";
+			exit(1);
+		}
+	}
+	cout << '\n';
+}
+
+// keys is sorted, and shuffled the same keys in random order
+template<typename Tree>
+void buildTimes(char const *name, vector<int> const &keys, vector<int> const &shuffled)
+{
+	Tree inserted, bulk, parallel;
+	double const insert = nsPerOp(keys.size(), [&] {
+		for (int k : shuffled)
+			inserted.insert(k);
+	});
+	double const bulkLoad = nsPerOp(keys.size(), [&] { bulk.bulk_load(keys.begin(), keys.end()); });
+	double const parallelLoad = nsPerOp(keys.size(), [&] {
+		mpcs51044::parallel_bulk_load(parallel, shuffled.begin(), shuffled.end());
+	});
+	if (bulk.size() != keys.size() || parallel.size() != keys.size()
+		|| !all_of(keys.begin(), keys.end(), [&](int k) { return bulk.search(k) && parallel.search(k); })) {
+		cerr << name << " is missing keys after bulk_load\n";
+		exit(1);
+	}
+	cout << setw(12) << name << setw(10) << insert << setw(10) << bulkLoad << setw(10) << parallelLoad << '\n';
+}
+
+template<typename Tree>
+void frozenTimes(char const *name, vector<int> const &keys, vector<int> const &shuffled, vector<int> const &missing)
+{
+	Tree tree;
+	tree.bulk_load(keys.begin(), keys.end());
+	mpcs51044::eytzinger_index const frozen = tree.freeze();
+	size_t found = 0;
+	double const hit = nsPerOp(shuffled.size(), [&] {
+		for (int k : shuffled)
+			found += frozen.search(k);
+	});
+	double const miss = nsPerOp(missing.size(), [&] {
+		for (int k : missing)
+			found += frozen.search(k);
+	});
+	doNotOptimize(found);
+	if (found != keys.size()) {
+		cerr << name << "'s frozen index found " << found << " of " << keys.size() << " keys\n";
+		exit(1);
+	}
+	cout << setw(12) << name << setw(10) << hit << setw(10) << miss << '\n';
+}
+
+// Ranges of 1000 keys starting at random places
+template<typename Tree>
+void scanTimes(char const *name, vector<int> const &keys, mt19937 &rng)
+{
+	Tree tree;
+	tree.bulk_load(keys.begin(), keys.end());
+	size_t const span = min<size_t>(1000, keys.size());
+	uniform_int_distribution<size_t> start(0, keys.size() - span);
+	vector<int> starts(1000);
+	for (int &s : starts)
+		s = keys[start(rng)];
+	size_t visited = 0;
+	long long sum = 0;
+	double const scan = nsPerOp(starts.size() * span, [&] {
+		for (int s : starts)
+			tree.for_each_in_range(s, s + 2 * static_cast<int>(span), [&](int k) {
+				sum += k;
+				visited++;
+			});
+	});
+	doNotOptimize(sum);
+	if (visited != starts.size() * span) {
+		cerr << name << " visited " << visited << " keys instead of " << starts.size() * span << '\n';
+		exit(1);
+	}
+	cout << setw(12) << name << setw(10) << scan << '\n';
+}
+
+int main(int argc, char *argv[])
+{
+	size_t const n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+	cout << fixed << setprecision(1);
+
+	// Even keys are in the tree, odd ones are not
+	vector<int> keys(n);
+	for (size_t i = 0; i < n; i++)
+		keys[i] = static_cast<int>(2 * i);
+	vector<int> missing(keys);
+	for (int &k : missing)
+		k++;
+	mt19937 rng(51044);
+	shuffle(missing.begin(), missing.end(), rng);
+
+	cout << setw(12) << "tree" << setw(10) << "keys" << setw(10) << "insert"
+		<< setw(10) << "hit" << setw(10) << "miss" << setw(10) << "erase" << "  (ns/op)\n";
+
+	cout << "random order\n";
+	vector<int> shuffled(keys);
+	shuffle(shuffled.begin(), shuffled.end(), rng);
+	run<mpcs51044::bplus_tree>("bplus_tree", shuffled, missing);
+	run<mpcs51044::btree>("btree", shuffled, missing);
+	run<Btree>("Btree", shuffled, missing);
+
+	cout << "sorted order\n";
+	run<mpcs51044::bplus_tree>("bplus_tree", keys, missing);
+	run<mpcs51044::btree>("btree", keys, missing);
+	vector<int> const few(keys.begin(), keys.begin() + n / 100);
+	vector<int> const fewMissing(missing.begin(), missing.begin() + n / 100);
+	run<Btree>("Btree", few, fewMissing);
+
+	cout << "building from n keys (ns/key)\n"
+		<< setw(12) << "tree" << setw(10) << "insert" << setw(10) << "bulk" << setw(10) << "parallel" << '\n';
+	buildTimes<mpcs51044::btree>("btree", keys, shuffled);
+	buildTimes<mpcs51044::bplus_tree>("bplus_tree", keys, shuffled);
+
+	cout << "frozen (ns/op)\n"
+		<< setw(12) << "from" << setw(10) << "hit" << setw(10) << "miss" << '\n';
+	frozenTimes<mpcs51044::btree>("btree", keys, shuffled, missing);
+	frozenTimes<mpcs51044::bplus_tree>("bplus_tree", keys, shuffled, missing);
+	size_t found = 0;
+	double const hit = nsPerOp(n, [&] {
+		for (int k : shuffled)
+			found += binary_search(keys.begin(), keys.end(), k);
+	});
+	double const miss = nsPerOp(n, [&] {
+		for (int k : missing)
+			found += binary_search(keys.begin(), keys.end(), k);
+	});
+	doNotOptimize(found);
+	cout << setw(12) << "sorted array" << setw(10) << hit << setw(10) << miss << '\n';
+
+	cout << "range scans (ns/key)\n";
+	scanTimes<mpcs51044::btree>("btree", keys, rng);
+	scanTimes<mpcs51044::bplus_tree>("bplus_tree", keys, rng);
+	return 0;
+}
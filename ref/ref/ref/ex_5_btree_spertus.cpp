@@ -1,120 +1,56 @@
-#ifndef btree_h
-#  define btree_h
-// Adapted from http://www.cprogramming.com/tutorial/lesson18.html 
-// 1. Owning pointers become unique_ptr
-// 2. node moved inside btree
-// 3. Get rid of destructor and destroy_tree because cleanup is
-//    automatically managed by RAII
-// 4. Make search() const
-// 5. Make search return a bool to encapsulate nodes away from user
-// 6. Constructors don't need to null pointers any more. That is handled
-//    by unique_ptr<>'s constructor]
-// 7. Add namespace and include guard
-// 8. Add copy constructor and assignment operator that
-//    deep copy
-// 9. Add move constructor and move assignment that shallow move
-
-#include<memory>
-#include<utility>
-using std::unique_ptr;
-using std::make_unique;
-
-namespace mpcs51044 {
-
-class btree
+#include "ex_5_btree_spertus.h"
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+using namespace mpcs51044;
+using namespace std;
+
+int main()
 {
-    public:
-		btree() = default;
-
-		// Copy construction and assignment deep copy
-		btree(btree const &other) {
-			if (other.root)
-				root = make_unique<node>(*other.root);
-		}
-		btree &operator=(btree const &other) {
-			if (&other != this) // Do nothing if self-assignment
-				if (other.root)
-					root = make_unique<node>(*other.root);
-				else
-					root.reset();
-			return *this;
-		}
-
-		// Move construction and assignment shallow copy. See lecture notes
-		btree(btree &&other) = default; // implicitly noexcept
-		void operator=(btree &&other) noexcept { swap(root, other.root); }
-
-		void insert(int key) {
-			if (root)
-				insert(key, *root);
-			else
-			{
-				root = make_unique<node>(key);
-			}
-		}
-		bool search(int key) const {
-			return search(key, root.get());
-		}
-
-    private:
-		struct node
-		{
-			node(int key_value) : key_value(key_value) {}
-			node(node const &other) : key_value(other.key_value) {
-				if (other.left)
-					left = make_unique<node>(*other.left);
-				if (other.right)
-					right = make_unique<node>(*other.right);
-			}
-			node &operator=(node const &other) {
-				key_value = other.key_value;
-				if (other.left)
-					left = make_unique<node>(*other.left);
-				if (other.right)
-					right = make_unique<node>(*other.right);
-				return *this;
-			}
-			int key_value;
-			unique_ptr<node> left;
-			unique_ptr<node> right;
-		};
-
-		void insert(int key, node &leaf) {
-			if (key< leaf.key_value)
-			{
-				if (leaf.left )
-					insert(key, *leaf.left);
-				else
-				{
-					leaf.left = make_unique<node>(key);
-				}
-			}
-			else if (key >= leaf.key_value)
-			{
-				if (leaf.right)
-					insert(key, *leaf.right);
-				else
-					leaf.right = make_unique<node>(key);
-			}
-		}
-		bool search(int key, node *leaf) const {
-			if (leaf)
-			{
-				if (key == leaf->key_value)
-					return leaf;
-				if (key<leaf->key_value)
-					return search(key, leaf->left.get());
-				else
-					return search(key, leaf->right.get());
-			}
-			else return false;
-		}
-
-		unique_ptr<node> root;
-};
+	btree tree;
+	tree.insert(2);
+	tree.insert(6);
+	tree.insert(2);
+	tree.insert(3);
+	tree.insert(10);
+	tree.insert(1);
+	cout << "3 is " << (tree.search(3) ? "" : "not ") << "in the tree\n";
+	cout << "4 is " << (tree.search(4) ? "" : "not ") << "in the tree\n";
+
+	cout << "in order:";
+	for (int key : tree)
+		cout << ' ' << key;
+	cout << "\nfrom 2 up to 6:";
+	tree.for_each_in_range(2, 6, [](int key) { cout << ' ' << key; });
+	cout << "\nthe first key above 3 is " << *tree.upper_bound(3) << '\n';
+
+	btree copied(tree); // copy constructor
+	btree assigned;
+	assigned = tree;    // copy assignment
+	btree moved(std::move(copied));
+	cout << "after copying and moving, 10 is " << (moved.search(10) && assigned.search(10) ? "" : "not ") << "in both\n";
+
+	btree_map<string, string> capitals;
+	capitals.insert({ "France", "Paris" });
+	capitals.try_emplace("Japan", "Tokyo");
+	capitals.try_emplace("Japan", "Kyoto"); // Already there, so ignored
+	string_view const japan = "Japan";      // Found without making a string
+	cout << "the capital of " << japan << " is " << *capitals.find(japan) << '\n';
+
+	// Nodes from a memory resource: polymorphic_allocator never propagates,
+	// so each tree keeps its own resource through assignment, and moving
+	// between trees on different resources moves the keys one by one
+	using pmr_btree = basic_btree<int, void, less<>, pmr::polymorphic_allocator<int>>;
+	pmr::monotonic_buffer_resource arena, otherArena;
+	pmr_btree fromArena(less<>(), &arena);
+	int const sorted[] = { 1, 2, 3, 5, 8, 13 };
+	fromArena.bulk_load(begin(sorted), end(sorted));
+	pmr_btree elsewhere(less<>(), &otherArena);
+	elsewhere = fromArena;              // copy assignment
+	pmr_btree swapped(less<>(), &otherArena);
+	swapped.swap(elsewhere);            // same resource, so the nodes just trade places
+	elsewhere = std::move(fromArena);   // different resource: the keys are moved over
+	cout << "pmr trees: " << swapped.size() << " and " << elsewhere.size() << " keys, "
+		<< (elsewhere.get_allocator().resource() == &otherArena ? "still" : "no longer") << " in their own arena\n";
 }
-#endif
-
-
-
-
@@ -0,0 +1,614 @@
+#ifndef btree_h
+#  define btree_h
+// Adapted from http://www.cprogramming.com/tutorial/lesson18.html 
+// 1. Owning pointers become unique_ptr
+// 2. node moved inside btree
+// 3. Get rid of destructor and destroy_tree because cleanup is
+//    automatically managed by RAII
+// 4. Make search() const
+// 5. Make search return a bool to encapsulate nodes away from user
+// 6. Constructors don't need to null pointers any more. That is handled
+//    by unique_ptr<>'s constructor]
+// 7. Add namespace and include guard
+// 8. Add copy constructor and assignment operator that
+//    deep copy
+// 9. Add move constructor and move assignment that shallow move
+// 10. Keep the tree balanced (AVL): the two subtrees of every node differ
+//     in height by at most one, so the height stays below 1.44 log2(n)
+//     whatever order the keys arrive in. Before, sorted keys built a list.
+// 11. insert, search and the new erase walk down the tree in a loop, and
+//     rebalance on the way back up from a path recorded in an array. The
+//     destructor and copying don't recurse either, so no operation's stack
+//     use grows with the size of the tree
+// 12. insert leaves keys that are already there alone (they used to go into
+//     the right subtree again) and returns whether it added the key
+// 13. Nodes come from a node_pool the tree owns rather than one make_unique
+//     each, so inserts rarely call malloc and nearby nodes share cache lines.
+//     The pool frees them all at once, so node pointers go back to being
+//     plain pointers (undoing 1.) and clear() is O(number of chunks)
+// 14. bulk_load builds the tree from sorted keys in O(n) instead of n
+//     inserts: every subtree takes the middle key of its range as its root,
+//     so it comes out as balanced as a binary tree can be
+// 15. freeze() copies the keys into an eytzinger_index, for lookups into an
+//     unchanging snapshot without chasing node pointers
+// 16. The tree becomes basic_btree<Key, Value, Compare, Allocator>. With a
+//     Value it is an ordered map holding pair<Key const, Value> (btree_map);
+//     without one (Value = void) a set of keys. btree is still the set of
+//     ints it always was. The default Compare, less<>, is transparent, so
+//     lookups take anything comparable with Key: a btree_map<string, ...>
+//     can be searched with a string_view (or a literal) without building a
+//     std::string, as in 6_string_view.cpp. insert moves what it's given
+//     into the node, and try_emplace only builds the value (and key) once
+//     it knows the key isn't there yet
+// 17. Since a key may no longer be copyable or assignable, erase relinks
+//     the next larger node in place of the one it removes instead of
+//     copying its key over
+// 18. Nodes point back to their parent, which gives the tree bidirectional
+//     iterators (begin()/end(), lower_bound, upper_bound) that need no
+//     stack, and for_each_in_range(lo, hi, f), which visits the k keys in
+//     [lo, hi) in O(log n + k)
+// 19. The Allocator propagates the way the standard containers' do, so a
+//     std::pmr tree works: a copy gets select_on_container_copy_construction
+//     of the original's, and assignment and swap only hand the allocator
+//     over when its propagate_on_container_* traits say to. Moving into a
+//     tree whose allocator isn't equal moves the values one by one
+
+#include<algorithm>
+#include<bit>
+#include<concepts>
+#include<cstddef>
+#include<functional>
+#include<iterator>
+#include<memory>
+#include<stdexcept>
+#include<tuple>
+#include<type_traits>
+#include<utility>
+#include<vector>
+#include"ex_5_eytzinger.h"
+#include"ex_5_node_pool.h"
+
+namespace mpcs51044 {
+
+template<typename Key, typename Value = void, typename Compare = std::less<>,
+		 typename Allocator = std::allocator<std::conditional_t<std::is_void_v<Value>, Key, std::pair<Key const, Value>>>>
+class basic_btree
+{
+	static constexpr bool is_map = !std::is_void_v<Value>;
+	// Lookups take a Key, or anything else a transparent Compare can
+	// compare with one
+	template<typename K>
+	static constexpr bool lookup_key = std::is_same_v<std::remove_cvref_t<K>, Key> || requires { typename Compare::is_transparent; };
+
+	struct node;
+	template<bool is_const> class basic_iterator;
+	using alloc_traits = std::allocator_traits<Allocator>;
+
+    public:
+		using key_type = Key;
+		using mapped_type = Value;
+		using value_type = std::conditional_t<is_map, std::pair<Key const, Value>, Key>;
+		using key_compare = Compare;
+		using allocator_type = Allocator;
+		// A set's keys can't be changed in place, so both of its iterators
+		// are const
+		using iterator = basic_iterator<!is_map>;
+		using const_iterator = basic_iterator<true>;
+
+		basic_btree() = default;
+		explicit basic_btree(Compare const &comp, Allocator const &alloc = Allocator())
+			: comp(comp), nodes(alloc) {}
+		~basic_btree() { clear(); }
+
+		// Copy construction and assignment deep copy
+		basic_btree(basic_btree const &other)
+			: basic_btree(other, alloc_traits::select_on_container_copy_construction(other.get_allocator())) {}
+		basic_btree(basic_btree const &other, Allocator const &alloc) : comp(other.comp), nodes(alloc), count(other.count) {
+			// Nodes still to copy, where each copy goes, and its parent
+			std::vector<std::tuple<node const *, node **, node *>> pending;
+			if (other.root)
+				pending.emplace_back(other.root, &root, nullptr);
+			try {
+				while (!pending.empty()) {
+					auto [from, to, parent] = pending.back();
+					pending.pop_back();
+					*to = nodes.make(from->value);
+					(*to)->height = from->height;
+					(*to)->parent = parent;
+					if (from->left)
+						pending.emplace_back(from->left, &(*to)->left, *to);
+					if (from->right)
+						pending.emplace_back(from->right, &(*to)->right, *to);
+				}
+			} catch (...) {
+				// Links not reached yet are still null, so clear() sees a
+				// (smaller) tree
+				clear();
+				throw;
+			}
+		}
+		basic_btree &operator=(basic_btree const &other) {
+			if (&other != this) { // Do nothing if self-assignment
+				if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+					if (get_allocator() != other.get_allocator()) {
+						clear();
+						nodes.release(other.get_allocator());
+					}
+				}
+				basic_btree copied(other, get_allocator());
+				swap(copied);
+			}
+			return *this;
+		}
+
+		// Move construction and assignment shallow copy. See lecture notes
+		basic_btree(basic_btree &&other) noexcept
+			: comp(other.comp), nodes(std::move(other.nodes)), root(std::exchange(other.root, nullptr)),
+			  count(std::exchange(other.count, 0)) {}
+		basic_btree &operator=(basic_btree &&other)
+			noexcept(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value) {
+			if (&other == this)
+				return *this;
+			if constexpr (!alloc_traits::propagate_on_container_move_assignment::value && !alloc_traits::is_always_equal::value) {
+				if (get_allocator() != other.get_allocator()) {
+					// other's nodes have to go back to its own allocator, so
+					// move its values into nodes made from ours
+					basic_btree moved(other.comp, get_allocator());
+					moved.build(std::make_move_iterator(other.begin()), other.count);
+					swap(moved);
+					other.clear();
+					return *this;
+				}
+			}
+			clear();
+			comp = std::move(other.comp);
+			nodes = std::move(other.nodes);
+			root = std::exchange(other.root, nullptr);
+			count = std::exchange(other.count, 0);
+			return *this;
+		}
+
+		// The allocators must be equal unless they propagate on swap
+		void swap(basic_btree &other) noexcept {
+			using std::swap;
+			swap(comp, other.comp);
+			nodes.swap(other.nodes);
+			swap(root, other.root);
+			swap(count, other.count);
+		}
+
+		// Returns false (and changes nothing) if the key was already there
+		bool insert(value_type const &value) { return emplace_at(key_of(value), value); }
+		bool insert(value_type &&value) { return emplace_at(key_of(value), std::move(value)); }
+
+		// Add key with a Value made from args, unless key is already there
+		// (in which case neither is touched). Returns the key's Value and
+		// whether it was added
+		template<typename K, typename... Args>
+			requires is_map && lookup_key<K> && std::constructible_from<Key, K &&>
+		std::pair<Value *, bool> try_emplace(K &&key, Args &&...args) {
+			node *added = nullptr;
+			node *const n = find_or_emplace(key, added, std::piecewise_construct,
+				std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+			return { &n->value.second, added != nullptr };
+		}
+
+		template<typename K> requires lookup_key<K>
+		bool search(K const &key) const { return find_node(key); }
+
+		// In key order. end() is one past the largest key, and -- from it
+		// gets back there
+		iterator begin() { return { leftmost(root), this }; }
+		iterator end() { return { nullptr, this }; }
+		const_iterator begin() const { return { leftmost(root), this }; }
+		const_iterator end() const { return { nullptr, this }; }
+
+		// The first key not below key, and the first key above it
+		template<typename K> requires lookup_key<K>
+		iterator lower_bound(K const &key) { return { bound<false>(key), this }; }
+		template<typename K> requires lookup_key<K>
+		const_iterator lower_bound(K const &key) const { return { bound<false>(key), this }; }
+		template<typename K> requires lookup_key<K>
+		iterator upper_bound(K const &key) { return { bound<true>(key), this }; }
+		template<typename K> requires lookup_key<K>
+		const_iterator upper_bound(K const &key) const { return { bound<true>(key), this }; }
+
+		// Call f on each value whose key is in [lo, hi), in order
+		template<typename Lo, typename Hi, typename F> requires lookup_key<Lo> && lookup_key<Hi>
+		void for_each_in_range(Lo const &lo, Hi const &hi, F &&f) const {
+			for (node const *n = bound<false>(lo); n && comp(key_of(n->value), hi); n = successor(n))
+				f(n->value);
+		}
+
+		// key's Value, or nullptr if key isn't there
+		template<typename K> requires (is_map && lookup_key<K>)
+		Value *find(K const &key) {
+			node *n = find_node(key);
+			return n ? &n->value.second : nullptr;
+		}
+		template<typename K> requires (is_map && lookup_key<K>)
+		Value const *find(K const &key) const {
+			node const *n = find_node(key);
+			return n ? &n->value.second : nullptr;
+		}
+
+		// Returns false if key wasn't there
+		template<typename K> requires lookup_key<K>
+		bool erase(K const &key) {
+			node **path[max_height];
+			int depth = 0;
+			node **link = &root;
+			while (*link && !equivalent(key, key_of((*link)->value))) {
+				path[depth++] = link;
+				link = comp(key, key_of((*link)->value)) ? &(*link)->left : &(*link)->right;
+			}
+			if (!*link)
+				return false;
+			node *const found = *link;
+			if (found->left && found->right) {
+				// The next larger node takes found's place. It has no left
+				// child, so its right child takes its own place first
+				int const found_depth = depth;
+				path[depth++] = link;
+				node **next_link = &found->right;
+				while ((*next_link)->left) {
+					path[depth++] = next_link;
+					next_link = &(*next_link)->left;
+				}
+				node *const next = *next_link;
+				*next_link = next->right;
+				if (next->right)
+					next->right->parent = next->parent;
+				next->left = found->left;
+				next->left->parent = next;
+				next->right = found->right;
+				if (next->right)
+					next->right->parent = next;
+				next->parent = found->parent;
+				next->height = found->height;
+				*link = next;
+				// The path went through found's right link, which is next's now
+				if (depth > found_depth + 1)
+					path[found_depth + 1] = &next->right;
+			} else {
+				node *const child = found->left ? found->left : found->right;
+				*link = child;
+				if (child)
+					child->parent = found->parent;
+			}
+			nodes.destroy(found);
+			count--;
+			while (depth)
+				rebalance(*path[--depth]);
+			return true;
+		}
+
+		// Replace the contents with the values in [first, last), whose keys
+		// must be strictly ascending. Throws invalid_argument (leaving the
+		// tree as it was) if they aren't
+		template<std::forward_iterator Iter>
+		void bulk_load(Iter first, Iter last) {
+			basic_btree loaded(comp, nodes.get_allocator());
+			loaded.build(first, static_cast<std::size_t>(std::distance(first, last)));
+			swap(loaded);
+		}
+
+		// The keys as they are now, searchable without the tree
+		eytzinger_index freeze() const requires std::same_as<Key, int> {
+			std::vector<int> keys;
+			keys.reserve(count);
+			for (value_type const &value : *this)
+				keys.push_back(key_of(value));
+			return eytzinger_index(keys.begin(), keys.end());
+		}
+
+		std::size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		key_compare key_comp() const { return comp; }
+		allocator_type get_allocator() const { return nodes.get_allocator(); }
+		void clear() {
+			destroy(root);
+			nodes.release();
+			root = nullptr;
+			count = 0;
+		}
+
+    private:
+		struct node
+		{
+			template<typename... Args>
+			explicit node(Args &&...args) : value(std::forward<Args>(args)...) {}
+			value_type value;
+			int height = 1; // of the subtree rooted here
+			node *left = nullptr;
+			node *right = nullptr;
+			node *parent = nullptr;
+		};
+
+		template<bool is_const>
+		class basic_iterator
+		{
+			public:
+				using iterator_category = std::bidirectional_iterator_tag;
+				using difference_type = std::ptrdiff_t;
+				using value_type = basic_btree::value_type;
+				using reference = std::conditional_t<is_const, value_type const &, value_type &>;
+				using pointer = std::conditional_t<is_const, value_type const *, value_type *>;
+
+				basic_iterator() = default;
+				// iterator converts to const_iterator
+				template<bool other_const> requires (is_const && !other_const)
+				basic_iterator(basic_iterator<other_const> const &other) : n(other.n), tree(other.tree) {}
+
+				reference operator*() const { return n->value; }
+				pointer operator->() const { return &n->value; }
+				basic_iterator &operator++() { n = successor(n); return *this; }
+				basic_iterator operator++(int) { basic_iterator old = *this; ++*this; return old; }
+				basic_iterator &operator--() { n = n ? predecessor(n) : rightmost(tree->root); return *this; }
+				basic_iterator operator--(int) { basic_iterator old = *this; --*this; return old; }
+				friend bool operator==(basic_iterator const &a, basic_iterator const &b) { return a.n == b.n; }
+
+			private:
+				friend class basic_btree;
+				friend class basic_iterator<!is_const>;
+				basic_iterator(node *n, basic_btree const *tree) : n(n), tree(tree) {}
+				node *n = nullptr;
+				basic_btree const *tree = nullptr;
+		};
+
+		static node *leftmost(node *n) {
+			if (n)
+				while (n->left)
+					n = n->left;
+			return n;
+		}
+		static node *rightmost(node *n) {
+			if (n)
+				while (n->right)
+					n = n->right;
+			return n;
+		}
+		// The node after n in key order: the first one in its right
+		// subtree, or else the first ancestor whose left subtree it is in
+		// (predecessor is the mirror image)
+		template<typename Node>
+		static Node *successor(Node *n) {
+			if (n->right)
+				return leftmost(n->right);
+			while (n->parent && n == n->parent->right)
+				n = n->parent;
+			return n->parent;
+		}
+		static node *predecessor(node *n) {
+			if (n->left)
+				return rightmost(n->left);
+			while (n->parent && n == n->parent->left)
+				n = n->parent;
+			return n->parent;
+		}
+
+		// The first node whose key is not below key (or, with above, is
+		// above it)
+		template<bool above, typename K>
+		node *bound(K const &key) const {
+			node *n = root;
+			node *found = nullptr;
+			while (n) {
+				if (above ? comp(key, key_of(n->value)) : !comp(key_of(n->value), key)) {
+					found = n;
+					n = n->left;
+				} else {
+					n = n->right;
+				}
+			}
+			return found;
+		}
+
+		// With less<>, a and b are equivalent just when they are equal, and
+		// testing that with == (rather than two calls to comp) lets the
+		// compiler keep the loops going down the tree free of hard to
+		// predict branches
+		template<typename A, typename B>
+		bool equivalent(A const &a, B const &b) const {
+			if constexpr (std::is_same_v<Compare, std::less<>> && requires { { a == b } -> std::convertible_to<bool>; })
+				return a == b;
+			else
+				return !comp(a, b) && !comp(b, a);
+		}
+
+		static Key const &key_of(value_type const &value) {
+			if constexpr (is_map)
+				return value.first;
+			else
+				return value;
+		}
+
+		// An AVL tree of height h has at least fib(h + 2) - 1 nodes, so this
+		// is enough for any tree that fits in memory
+		static constexpr int max_height = 96;
+
+		// Run the destructors of the nodes under n, if they have any (the
+		// pool frees the memory). Rotating left children up until there
+		// are none turns the tree into a list down the right links, and
+		// nodes come off the front of it as it goes
+		void destroy(node *n) {
+			if constexpr (!std::is_trivially_destructible_v<node>) {
+				while (n) {
+					if (node *left = n->left) {
+						n->left = left->right;
+						left->right = n;
+						n = left;
+					} else {
+						node *right = n->right;
+						nodes.destroy(n);
+						n = right;
+					}
+				}
+			}
+		}
+
+		template<typename K>
+		node *find_node(K const &key) const {
+			node *n = root;
+			while (n && !equivalent(key, key_of(n->value)))
+				n = comp(key, key_of(n->value)) ? n->left : n->right;
+			return n;
+		}
+
+		template<typename... Args>
+		bool emplace_at(Key const &key, Args &&...args) {
+			node *added = nullptr;
+			find_or_emplace(key, added, std::forward<Args>(args)...);
+			return added != nullptr;
+		}
+
+		// The node with key, which is made from args (and reported in
+		// added) only if key wasn't there yet
+		template<typename K, typename... Args>
+		node *find_or_emplace(K const &key, node *&added, Args &&...args) {
+			node **path[max_height];
+			int depth = 0;
+			node **link = &root;
+			node *parent = nullptr;
+			while (*link && !equivalent(key, key_of((*link)->value))) {
+				path[depth++] = link;
+				parent = *link;
+				link = comp(key, key_of((*link)->value)) ? &(*link)->left : &(*link)->right;
+			}
+			if (*link)
+				return *link;
+			added = *link = nodes.make(std::forward<Args>(args)...);
+			added->parent = parent;
+			count++;
+			// Once a subtree is as high as before, nothing above it changes
+			while (depth) {
+				node *&subtree = *path[--depth];
+				int const height = subtree->height;
+				rebalance(subtree);
+				if (subtree->height == height)
+					break;
+			}
+			return added;
+		}
+
+		static int height(node const *n) { return n ? n->height : 0; }
+		static int balance(node const &n) { return height(n.left) - height(n.right); }
+		static void update(node &n) { n.height = 1 + std::max(height(n.left), height(n.right)); }
+
+		// Make subtree's left child its root (rotate_left is the mirror image)
+		static void rotate_right(node *&subtree) {
+			node *left = subtree->left;
+			subtree->left = left->right;
+			if (left->right)
+				left->right->parent = subtree;
+			update(*subtree);
+			left->right = subtree;
+			left->parent = subtree->parent;
+			subtree->parent = left;
+			subtree = left;
+			update(*subtree);
+		}
+		static void rotate_left(node *&subtree) {
+			node *right = subtree->right;
+			subtree->right = right->left;
+			if (right->left)
+				right->left->parent = subtree;
+			update(*subtree);
+			right->left = subtree;
+			right->parent = subtree->parent;
+			subtree->parent = right;
+			subtree = right;
+			update(*subtree);
+		}
+
+		// Restore the AVL property at subtree, whose children already have it
+		// and differ in height by at most two
+		static void rebalance(node *&subtree) {
+			update(*subtree);
+			int const b = balance(*subtree);
+			if (b > 1) {
+				if (balance(*subtree->left) < 0)
+					rotate_left(subtree->left);
+				rotate_right(subtree);
+			} else if (b < -1) {
+				if (balance(*subtree->right) > 0)
+					rotate_right(subtree->right);
+				rotate_left(subtree);
+			}
+		}
+
+		// Make the total values starting at next into a tree, in order, so they
+		// are read once and nodes are made in key order. A subtree of the
+		// range [lo, hi) has the value at mid = lo + (hi - lo - 1) / 2 as its
+		// root, so its two sides differ in size by at most one, and its
+		// height is bit_width(hi - lo). Each frame waits for its left subtree
+		// and then becomes its own right subtree, so there are never more
+		// frames than levels. If this throws, the finished left subtrees
+		// still waiting in frames are destroyed here, and everything else
+		// made so far hangs off root
+		template<typename Iter>
+		void build(Iter next, std::size_t total) {
+			// A left subtree's root learns its parent once the parent is made
+			struct frame {
+				std::size_t lo, hi;
+				node **out;
+				node *parent = nullptr;
+				node *left = nullptr;
+				bool left_built = false;
+			};
+			frame stack[max_height];
+			int depth = 0;
+			stack[depth++] = { 0, total, &root };
+			node const *previous = nullptr;
+			nodes.reserve(total);
+			try {
+				while (depth) {
+					frame &f = stack[depth - 1];
+					if (f.lo == f.hi) {
+						*f.out = nullptr;
+						depth--;
+						continue;
+					}
+					std::size_t const mid = f.lo + (f.hi - f.lo - 1) / 2;
+					if (!f.left_built) {
+						f.left_built = true;
+						stack[depth++] = { f.lo, mid, &f.left };
+						continue;
+					}
+					node *n = nodes.make(*next++);
+					if (previous && !comp(key_of(previous->value), key_of(n->value))) {
+						nodes.destroy(n);
+						throw std::invalid_argument("btree::bulk_load needs strictly ascending keys");
+					}
+					n->left = f.left;
+					if (f.left)
+						f.left->parent = n;
+					n->parent = f.parent;
+					n->height = static_cast<int>(std::bit_width(f.hi - f.lo));
+					*f.out = n;
+					count++;
+					previous = n;
+					f = { mid + 1, f.hi, &n->right, n };
+				}
+			} catch (...) {
+				for (int i = 0; i < depth; i++)
+					destroy(stack[i].left);
+				throw;
+			}
+		}
+
+		[[no_unique_address]] Compare comp;
+		node_pool<node, Allocator> nodes;
+		node *root = nullptr;
+		std::size_t count = 0;
+};
+
+// An ordered map from Key to Value
+template<typename Key, typename Value, typename Compare = std::less<>,
+		 typename Allocator = std::allocator<std::pair<Key const, Value>>>
+using btree_map = basic_btree<Key, Value, Compare, Allocator>;
+
+// The original set of ints
+using btree = basic_btree<int>;
+}
+#endif
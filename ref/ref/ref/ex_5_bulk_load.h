@@ -0,0 +1,83 @@
+#ifndef BULK_LOAD_H
+#  define BULK_LOAD_H
+// btree::bulk_load and bplus_tree::bulk_load build a tree in O(n), but only
+// from keys that are already sorted. parallel_bulk_load takes keys in any
+// order (duplicates too): it copies them, sorts the copy on the thread pool
+// (each thread sorts a block, then neighbouring blocks are merged pairwise,
+// in parallel, until one is left), drops the duplicates, and bulk loads
+// the result.
+//
+// It sorts by the tree's key_comp(), applied to the key of each value (a
+// map's value is a pair, and only .first counts), and two keys are
+// duplicates when neither comes before the other. Both the sort and the
+// merges are stable, so of several values with equivalent keys the first
+// one in [first, last) is kept, like inserting them one at a time would.
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ex_7_thread_pool.h"
+
+namespace mpcs51044 {
+
+// Copy of [first, last) sorted by comp on key_of(value), keeping only the
+// first value with each key
+template<std::input_iterator Iter, typename Compare = std::less<>, typename KeyOf = std::identity>
+std::vector<std::iter_value_t<Iter>> parallel_sorted_keys(Iter first, Iter last, Compare comp = {}, KeyOf key_of = {},
+	thread_pool &pool = thread_pool::instance())
+{
+	using value_type = std::iter_value_t<Iter>;
+	auto const before = [&](value_type const &a, value_type const &b) -> bool {
+		return std::invoke(comp, std::invoke(key_of, a), std::invoke(key_of, b));
+	};
+	std::vector<value_type> keys(first, last);
+	std::size_t const n = keys.size();
+	std::size_t const blocks = std::max<std::size_t>(1, std::min<std::size_t>(pool.size() + 1, n / 4096));
+	// Block b is [bounds[b], bounds[b + 1])
+	std::vector<std::size_t> bounds(blocks + 1);
+	for (std::size_t b = 0; b <= blocks; b++)
+		bounds[b] = n * b / blocks;
+	parallel_for<std::size_t>(0, blocks, 1, [&](std::size_t b0, std::size_t b1) {
+		for (std::size_t b = b0; b < b1; b++)
+			std::stable_sort(keys.begin() + bounds[b], keys.begin() + bounds[b + 1], before);
+	}, pool);
+	// After the round with width w, each run of w blocks is sorted
+	for (std::size_t width = 1; width < blocks; width *= 2) {
+		std::size_t const pairs = (blocks + 2 * width - 1) / (2 * width);
+		parallel_for<std::size_t>(0, pairs, 1, [&](std::size_t p0, std::size_t p1) {
+			for (std::size_t p = p0; p < p1; p++) {
+				std::size_t const lo = 2 * width * p;
+				std::size_t const mid = std::min(lo + width, blocks);
+				std::size_t const hi = std::min(lo + 2 * width, blocks);
+				std::inplace_merge(keys.begin() + bounds[lo], keys.begin() + bounds[mid], keys.begin() + bounds[hi], before);
+			}
+		}, pool);
+	}
+	// Sorted, so a never comes after b, and they are equivalent unless it
+	// comes before
+	keys.erase(std::unique(keys.begin(), keys.end(),
+		[&](value_type const &a, value_type const &b) { return !before(a, b); }), keys.end());
+	return keys;
+}
+
+// Replace tree's contents with the keys in [first, last), in any order.
+// Anything after last (like bplus_tree's fill) goes on to bulk_load
+template<typename Tree, std::input_iterator Iter, typename... Args>
+void parallel_bulk_load(Tree &tree, Iter first, Iter last, Args &&...args)
+{
+	// A map's value_type is a (key, value) pair
+	auto const key_of = [](auto const &value) -> auto const & {
+		if constexpr (!std::is_same_v<typename Tree::value_type, typename Tree::key_type>)
+			return value.first;
+		else
+			return value;
+	};
+	auto const keys = parallel_sorted_keys(first, last, tree.key_comp(), key_of);
+	tree.bulk_load(keys.begin(), keys.end(), std::forward<Args>(args)...);
+}
+
+}
+#endif
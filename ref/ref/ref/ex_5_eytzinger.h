@@ -0,0 +1,100 @@
+#ifndef EYTZINGER_H
+#  define EYTZINGER_H
+// Searching btree or bplus_tree chases pointers to nodes wherever they were
+// allocated, and a binary search of a sorted array isn't much better: its
+// first probes are far apart, each one a cache miss the CPU can't start
+// until the previous comparison is done, and each branch on a comparison
+// is a coin flip the predictor loses half the time.
+//
+// eytzinger_index stores sorted keys the way a heap stores a complete binary
+// tree, in breadth-first order: the root is keys[1] and the children of
+// keys[k] are keys[2k] and keys[2k + 1]. A search is then
+//     k = 2 * k + (keys[k] < key)
+// in a loop, which compiles to a compare and an add with no branch to
+// mispredict. Since every step only ever goes down, the addresses it will
+// need are known early: the 16 descendants of keys[k] four levels down are
+// keys[16k..16k + 15], one 64-byte cache line when keys[0] starts a line,
+// so each step prefetches that line and by the time the search gets there
+// it is usually already in cache.
+//
+// The index is immutable. btree::freeze() and bplus_tree::freeze() make one
+// from a tree's keys, for lookups into a snapshot that no longer changes.
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+
+// Start loading the cache line holding p, without waiting for it or faulting
+// if p is past the end of the keys. Only a hint, so it can be nothing
+#if defined(__GNUC__) || defined(__clang__)
+#  define MPCS51044_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <xmmintrin.h>
+#  define MPCS51044_PREFETCH(p) _mm_prefetch(reinterpret_cast<char const *>(p), _MM_HINT_T0)
+#else
+#  define MPCS51044_PREFETCH(p) ((void)(p))
+#endif
+
+namespace mpcs51044 {
+
+class eytzinger_index {
+public:
+	eytzinger_index() = default;
+
+	// [first, last) must be in ascending order
+	template<std::forward_iterator Iter>
+	eytzinger_index(Iter first, Iter last)
+		: n(static_cast<std::size_t>(std::distance(first, last))),
+		  keys(static_cast<int *>(::operator new((n + 1) * sizeof(int), std::align_val_t{ cache_line })))
+	{
+		if (n == 0)
+			return;
+		// Visit the implicit tree in order: start at the leftmost node, and
+		// go to each node's successor in turn
+		std::size_t k = std::bit_floor(n);
+		for (; first != last; ++first) {
+			keys[k] = *first;
+			if (2 * k + 1 <= n) {
+				// Leftmost node of the right subtree
+				k = 2 * k + 1;
+				while (2 * k <= n)
+					k *= 2;
+			} else {
+				// Up past every ancestor we are the right child of, then one more
+				k >>= std::countr_one(k) + 1;
+			}
+		}
+	}
+
+	bool search(int key) const
+	{
+		int const *const base = keys.get();
+		std::size_t k = 1;
+		while (k <= n) {
+			MPCS51044_PREFETCH(base + 16 * k);
+			k = 2 * k + (base[k] < key);
+		}
+		// k went right at every step from the node holding the smallest key
+		// not below key, then left once (or never left, if there is none).
+		// Undo the trailing right turns and that left turn to find it
+		k >>= std::countr_one(k) + 1;
+		return k != 0 && base[k] == key;
+	}
+
+	std::size_t size() const { return n; }
+	bool empty() const { return n == 0; }
+
+private:
+	// keys[0] starts a cache line, so each group of 16 descendants fills one
+	static constexpr std::size_t cache_line = 64;
+	struct free_aligned {
+		void operator()(int *p) const { ::operator delete(p, std::align_val_t{ cache_line }); }
+	};
+
+	std::size_t n = 0;
+	std::unique_ptr<int[], free_aligned> keys; // keys[1..n]; keys[0] is unused
+};
+
+}
+#endif
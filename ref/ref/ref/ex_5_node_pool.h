@@ -0,0 +1,164 @@
+#ifndef NODE_POOL_H
+#  define NODE_POOL_H
+// A tree that calls new for every node pays for a trip through malloc on
+// each insert, and its nodes end up wherever the heap had room, so a parent
+// and its children are rarely near each other in memory.
+//
+// node_pool<T> hands out T-sized slots carved one after the other from
+// chunks it allocates in bulk (each chunk twice the size of the last, up to
+// max_chunk_bytes). Nodes created together, like the path an insert builds,
+// sit next to each other, and creating one is usually just bumping a
+// pointer. Destroyed nodes go on a free list for the next make() to reuse,
+// and release() or the pool's destructor frees every chunk at once, without
+// visiting the nodes. That skips the nodes' destructors, so a tree whose
+// nodes have real ones (say, holding strings) destroys them first.
+//
+// Chunks come from Allocator (rebound to the pool's slot type).
+//
+// A pool belongs to one tree and moves (or swaps) along with it; it isn't
+// thread-safe and can't be copied. The allocator follows the usual container
+// rules: it goes along on move assignment or swap only if its
+// propagate_on_container_move_assignment or _swap says so. Otherwise the two
+// pools must have equal allocators, since each frees its chunks with its own
+// (a tree with different allocators moves its values over one by one
+// instead).
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mpcs51044 {
+
+template<typename T, typename Allocator = std::allocator<T>>
+class node_pool {
+public:
+	static constexpr std::size_t min_chunk_slots = 16;
+	static constexpr std::size_t max_chunk_bytes = 1 << 20;
+
+	explicit node_pool(Allocator const &allocator = Allocator()) : alloc(allocator) {}
+	node_pool(node_pool const &) = delete;
+	node_pool &operator=(node_pool const &) = delete;
+	node_pool(node_pool &&other) noexcept : alloc(std::move(other.alloc)) { take(other); }
+	node_pool &operator=(node_pool &&other) noexcept {
+		if (this != &other) {
+			release();
+			if constexpr (slot_traits::propagate_on_container_move_assignment::value)
+				alloc = std::move(other.alloc);
+			take(other);
+		}
+		return *this;
+	}
+	~node_pool() { release(); }
+
+	void swap(node_pool &other) noexcept {
+		using std::swap;
+		if constexpr (slot_traits::propagate_on_container_swap::value)
+			swap(alloc, other.alloc);
+		chunks.swap(other.chunks);
+		swap(free_list, other.free_list);
+		swap(next_slot, other.next_slot);
+		swap(chunk_end, other.chunk_end);
+		swap(in_use, other.in_use);
+	}
+
+	template<typename... Args>
+	T *make(Args &&...args) {
+		if (!free_list && next_slot == chunk_end)
+			grow();
+		bool const reuse = free_list;
+		slot *s = reuse ? free_list : next_slot;
+		// T overwrites the link, so read it first, but only take the slot
+		// once T's constructor hasn't thrown
+		slot *const next_free = reuse ? s->next : nullptr;
+		T *p = new (s->storage) T(std::forward<Args>(args)...);
+		if (reuse)
+			free_list = next_free;
+		else
+			next_slot++;
+		in_use++;
+		return p;
+	}
+
+	// Destroy *p and give its slot back for reuse
+	void destroy(T *p) noexcept {
+		p->~T();
+		slot *s = reinterpret_cast<slot *>(p);
+		s->next = free_list;
+		free_list = s;
+		in_use--;
+	}
+
+	// Free every chunk; all nodes made from the pool are gone
+	void release() noexcept {
+		for (auto [chunk, slots] : chunks)
+			slot_traits::deallocate(alloc, chunk, slots);
+		chunks.clear();
+		free_list = next_slot = chunk_end = nullptr;
+		in_use = 0;
+	}
+
+	// Same, then take chunks from allocator from now on (for copy assigning
+	// a tree whose allocator propagates on copy assignment)
+	void release(Allocator const &allocator) noexcept {
+		release();
+		alloc = slot_allocator(allocator);
+	}
+
+	// Make sure the next n calls to make() take slots from one chunk, for
+	// building a tree whose size is known up front
+	void reserve(std::size_t n) {
+		if (static_cast<std::size_t>(chunk_end - next_slot) >= n)
+			return;
+		allocate(n);
+	}
+
+	Allocator get_allocator() const { return Allocator(alloc); }
+
+	// Nodes made and not yet destroyed
+	std::size_t size() const { return in_use; }
+
+private:
+	union slot {
+		slot *next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+	using slot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<slot>;
+	using slot_traits = std::allocator_traits<slot_allocator>;
+
+	void grow() {
+		std::size_t const last = chunks.empty() ? min_chunk_slots / 2 : chunks.back().second;
+		allocate(std::max<std::size_t>(1, std::min(2 * last, max_chunk_bytes / sizeof(slot))));
+	}
+
+	// Take over other's chunks and nodes, leaving it empty
+	void take(node_pool &other) noexcept {
+		chunks = std::move(other.chunks);
+		other.chunks.clear();
+		free_list = std::exchange(other.free_list, nullptr);
+		next_slot = std::exchange(other.next_slot, nullptr);
+		chunk_end = std::exchange(other.chunk_end, nullptr);
+		in_use = std::exchange(other.in_use, 0);
+	}
+
+	// Start carving from a new chunk of n slots
+	void allocate(std::size_t n) {
+		chunks.reserve(chunks.size() + 1);
+		next_slot = slot_traits::allocate(alloc, n);
+		chunk_end = next_slot + n;
+		chunks.emplace_back(next_slot, n);
+	}
+
+	[[no_unique_address]] slot_allocator alloc;
+	// Each chunk and its number of slots
+	std::vector<std::pair<slot *, std::size_t>> chunks;
+	slot *free_list = nullptr;
+	slot *next_slot = nullptr;
+	slot *chunk_end = nullptr;
+	std::size_t in_use = 0;
+};
+
+}
+#endif
@@ -0,0 +1,120 @@
+#include "ex_5_olc_tree.h"
+#include "ex_5_btree_spertus.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+//////////////////////////////////////////
+// CONCURRENT TREE BENCHMARK
+//////////////////////////////////////////
+// ex_5_olc_tree [max_threads] [n]
+//
+// Fills olc_tree and a btree behind a shared_mutex with n keys (default
+// 1000000), then has 1, 2, 4, ... up to max_threads (default 32) threads
+// each do a mix of 95% lookups and 5% inserts/erases for a fixed number of
+// operations, printing millions of operations per second. First it checks
+// that olc_tree doesn't lose keys when several threads insert at once.
+
+// btree the obvious way: readers share the lock, writers take it alone
+struct locked_btree {
+	bool insert(int key) { scoped_lock guard(m); return tree.insert(key); }
+	bool search(int key) const { shared_lock guard(m); return tree.search(key); }
+	bool erase(int key) { scoped_lock guard(m); return tree.erase(key); }
+	mpcs51044::btree tree;
+	mutable shared_mutex m;
+};
+
+// Keys below 2n that are even are in the tree to start with
+template<typename Tree>
+double mopsPerSecond(Tree &tree, unsigned threads, size_t n, size_t opsPerThread)
+{
+	atomic<size_t> found = 0;
+	vector<jthread> workers;
+	auto const start = chrono::steady_clock::now();
+	for (unsigned t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			mt19937 rng(51044 + t);
+			uniform_int_distribution<int> key(0, static_cast<int>(2 * n - 1));
+			uniform_int_distribution<int> percent(0, 99);
+			size_t hits = 0;
+			for (size_t i = 0; i < opsPerThread; i++) {
+				int const k = key(rng);
+				int const p = percent(rng);
+				// Writers only touch odd keys, so the even ones stay put
+				if (p < 95)
+					hits += tree.search(k);
+				else if (p < 98)
+					tree.insert(k | 1);
+				else
+					tree.erase(k | 1);
+			}
+			found += hits;
+		});
+	}
+	workers.clear();
+	chrono::duration<double> const elapsed = chrono::steady_clock::now() - start;
+	if (found.load() == 0) {
+		cerr << "no lookups hit\n";
+		exit(1);
+	}
+	return threads * opsPerThread / elapsed.count() / 1e6;
+}
+
+// Threads insert interleaved keys at once; all of them must be there after
+void checkConcurrentInserts(unsigned threads, int perThread)
+{
+	mpcs51044::olc_tree tree;
+	{
+		vector<jthread> workers;
+		for (unsigned t = 0; t < threads; t++)
+			workers.emplace_back([&, t] {
+				for (int i = 0; i < perThread; i++)
+					tree.insert(i * static_cast<int>(threads) + static_cast<int>(t));
+			});
+	}
+	int const total = perThread * static_cast<int>(threads);
+	for (int k = 0; k < total; k++) {
+		if (!tree.search(k)) {
+			cerr << "olc_tree lost key " << k << '\n';
+			exit(1);
+		}
+	}
+	if (tree.size() != static_cast<size_t>(total) || tree.search(total)) {
+		cerr << "olc_tree has the wrong keys\n";
+		exit(1);
+	}
+	cout << threads << " threads inserted " << total << " keys into olc_tree, none lost\n";
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned const maxThreads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 32;
+	size_t const n = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000000;
+	size_t const opsPerThread = 200000;
+
+	checkConcurrentInserts(maxThreads, 20000);
+
+	mpcs51044::olc_tree olc;
+	locked_btree locked;
+	for (size_t i = 0; i < n; i++) {
+		olc.insert(static_cast<int>(2 * i));
+		locked.insert(static_cast<int>(2 * i));
+	}
+
+	cout << "hardware threads: " << thread::hardware_concurrency() << '\n'
+		<< fixed << setprecision(1)
+		<< setw(8) << "threads" << setw(12) << "olc_tree" << setw(14) << "locked btree" << "  (Mops/s)\n";
+	for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+		cout << setw(8) << threads
+			<< setw(12) << mopsPerSecond(olc, threads, n, opsPerThread)
+			<< setw(14) << mopsPerSecond(locked, threads, n, opsPerThread) << '\n';
+	}
+	return 0;
+}
@@ -0,0 +1,374 @@
+#ifndef OLC_TREE_H
+#  define OLC_TREE_H
+// btree and bplus_tree have no synchronization, and wrapping one in a mutex
+// the way LockedStack (ex_5_stack_spertus.h) wraps its list serializes every
+// lookup. Even a reader-writer lock doesn't scale: every reader writes the
+// lock's counter, so its cache line bounces between all the cores.
+//
+// olc_tree is a B+-tree laid out like bplus_tree (ex_5_bplus_tree.h) that
+// uses optimistic lock coupling. Every node has a version word. A writer
+// makes it odd while it changes the node and bumps it to the next even
+// number when it's done. A reader never writes anything shared:
+//   1. read the node's version, waiting while it is odd
+//   2. read what it needs from the node (say, which child to go to)
+//   3. read the version again; if it changed, a writer got in the way and
+//      the lookup starts over from the root
+// and it only moves to a child once it has checked the parent, so it never
+// follows a pointer it read from a half-written node. Writers go down the
+// same way and only lock the nodes they change: the leaf, plus the parent
+// (and the node being split) when a full node has to be split. Like
+// bplus_tree's insert, they split full nodes on the way down, so a split
+// never has to reach further up than the parent.
+//
+// Readers can see a node while it's being written, so the fields they read
+// are atomics, accessed with relaxed loads and stores and ordered by the
+// fences around the version checks (as in a seqlock). On x86 those compile
+// to the same plain moves bplus_tree uses.
+//
+// Nodes are never freed while the tree exists, since a reader could still be
+// looking at one: erase just takes the key out of its leaf and leaves
+// underfull leaves alone, and splits move keys to new nodes without retiring
+// any. The memory comes back when the tree is destroyed.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include "ex_5_node_pool.h"
+
+namespace mpcs51044 {
+
+class olc_tree {
+public:
+	olc_tree() { root.store(make_leaf(), std::memory_order_release); }
+	// Other threads may hold pointers into the nodes, so the tree stays put
+	olc_tree(olc_tree const &) = delete;
+	olc_tree &operator=(olc_tree const &) = delete;
+
+	// All three are safe to call from any number of threads at once.
+	// insert returns false (and changes nothing) if key was already there;
+	// erase returns false if key wasn't there
+	bool insert(int key);
+	bool search(int key) const;
+	bool erase(int key);
+
+	// Exact once writers have finished
+	std::size_t size() const { return count.load(std::memory_order_relaxed); }
+	bool empty() const { return size() == 0; }
+
+	static constexpr std::size_t cache_line = 64;
+	static constexpr std::size_t node_bytes = 4 * cache_line;
+
+private:
+	struct node {
+		explicit node(bool is_leaf) : is_leaf(is_leaf) {}
+		// Odd while a writer holds the node
+		std::atomic<std::uint64_t> version = 0;
+		bool const is_leaf;
+		std::atomic<int> n = 0; // keys in use
+	};
+
+	static constexpr int leaf_capacity = (node_bytes - sizeof(node)) / sizeof(int);
+	static constexpr int inner_capacity =
+		(node_bytes - sizeof(node) - sizeof(void *)) / (sizeof(int) + sizeof(void *));
+
+	// keys[0..n) in ascending order
+	struct alignas(cache_line) leaf : node {
+		leaf() : node(true) {}
+		std::atomic<int> keys[leaf_capacity] = {};
+	};
+
+	// children[i] holds the keys k with keys[i-1] <= k < keys[i]
+	struct alignas(cache_line) inner : node {
+		inner() : node(false) {}
+		std::atomic<int> keys[inner_capacity] = {};
+		std::atomic<node *> children[inner_capacity + 1] = {};
+	};
+
+	static_assert(sizeof(leaf) == node_bytes && sizeof(inner) == node_bytes,
+		"A node should fill its cache lines exactly");
+
+	static constexpr auto relaxed = std::memory_order_relaxed;
+
+	// Version protocol. A failed check means: start over from the root
+
+	// Wait out any writer and return the (even) version to check against
+	static std::uint64_t read_lock(node const *n)
+	{
+		std::uint64_t v;
+		while ((v = n->version.load(std::memory_order_acquire)) & 1)
+			std::this_thread::yield();
+		return v;
+	}
+	// Whether nothing wrote n since read_lock returned v, so everything read
+	// from it in between is consistent
+	static bool validate(node const *n, std::uint64_t v)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return n->version.load(relaxed) == v;
+	}
+	// Take the write lock, but only if nothing wrote n since v
+	static bool upgrade(node *n, std::uint64_t v)
+	{
+		if (!n->version.compare_exchange_strong(v, v + 1, std::memory_order_acquire))
+			return false;
+		// Readers that see any of our stores must also see the odd version
+		std::atomic_thread_fence(std::memory_order_release);
+		return true;
+	}
+	static void unlock(node *n) { n->version.fetch_add(1, std::memory_order_release); }
+
+	// Number of keys[0..n) below key (or, with or_equal, not above it)
+	template<bool or_equal>
+	static int count_below(std::atomic<int> const *keys, int n, int key)
+	{
+		int below = 0;
+		for (int i = 0; i < n; i++) {
+			int const k = keys[i].load(relaxed);
+			below += or_equal ? k <= key : k < key;
+		}
+		return below;
+	}
+	static int child_index(inner const *in, int n, int key) { return count_below<true>(in->keys, n, key); }
+
+	static bool full(node const *n) { return n->n.load(relaxed) == (n->is_leaf ? leaf_capacity : inner_capacity); }
+
+	// Copy [first, last) of one atomic array to another starting at out,
+	// which may overlap it from above (like std::copy_backward)
+	template<typename T>
+	static void move_up(std::atomic<T> *first, std::atomic<T> *last, std::atomic<T> *out_last)
+	{
+		while (last != first)
+			(--out_last)->store((--last)->load(relaxed), relaxed);
+	}
+	template<typename T>
+	static void move_to(std::atomic<T> const *first, std::atomic<T> const *last, std::atomic<T> *out)
+	{
+		for (; first != last; ++first, ++out)
+			out->store(first->load(relaxed), relaxed);
+	}
+
+	// Writers allocate from pools shared by the whole tree; splits are rare
+	// enough that one mutex for them doesn't matter
+	leaf *make_leaf()
+	{
+		std::scoped_lock guard(pool_lock);
+		return leaves.make();
+	}
+	inner *make_inner()
+	{
+		std::scoped_lock guard(pool_lock);
+		return inners.make();
+	}
+
+	// Start at the root. It has to still be the root once we have its
+	// version, or a split may have moved half its keys under a new root
+	template<typename Node>
+	bool lock_root(Node *&n, std::uint64_t &v) const
+	{
+		n = root.load(std::memory_order_acquire);
+		v = read_lock(n);
+		return root.load(std::memory_order_acquire) == n;
+	}
+
+	// Move from the inner node n (as of version v) to the child that holds
+	// key. Checking n before touching the child means we never follow a
+	// pointer from a half-written node, and checking it again after reading
+	// the child's version means the child hadn't been split by then (that
+	// takes the parent's lock too), so key still belongs under it
+	template<typename Node>
+	static bool descend(Node *&n, std::uint64_t &v, int key)
+	{
+		auto *in = static_cast<std::conditional_t<std::is_const_v<Node>, inner const, inner> *>(n);
+		Node *child = in->children[child_index(in, in->n.load(relaxed), key)].load(relaxed);
+		if (!validate(in, v))
+			return false;
+		std::uint64_t const child_v = read_lock(child);
+		if (!validate(in, v))
+			return false;
+		n = child;
+		v = child_v;
+		return true;
+	}
+
+	// Split the full, locked n, whose locked parent is parent (or none if
+	// n is the root). Neither is unlocked.
+	void split(inner *parent, node *n);
+
+	std::mutex pool_lock;
+	node_pool<leaf> leaves;
+	node_pool<inner> inners;
+	std::atomic<node *> root;
+	std::atomic<std::size_t> count = 0;
+};
+
+inline bool olc_tree::search(int key) const
+{
+	for (;;) {
+		node const *n;
+		std::uint64_t v;
+		if (!lock_root(n, v))
+			continue;
+		bool restart = false;
+		while (!n->is_leaf) {
+			if (!descend(n, v, key)) {
+				restart = true;
+				break;
+			}
+		}
+		if (restart)
+			continue;
+		leaf const *l = static_cast<leaf const *>(n);
+		int const size = l->n.load(relaxed);
+		int const i = count_below<false>(l->keys, size, key);
+		bool const found = i < size && l->keys[i].load(relaxed) == key;
+		if (validate(l, v))
+			return found;
+	}
+}
+
+inline void olc_tree::split(inner *parent, node *n)
+{
+	int separator;
+	node *sibling;
+	int const size = n->n.load(relaxed);
+	int const keep = size / 2;
+	if (n->is_leaf) {
+		leaf *l = static_cast<leaf *>(n);
+		leaf *right = make_leaf();
+		move_to(l->keys + keep, l->keys + size, right->keys);
+		right->n.store(size - keep, relaxed);
+		separator = right->keys[0].load(relaxed);
+		sibling = right;
+	} else {
+		inner *in = static_cast<inner *>(n);
+		inner *right = make_inner();
+		separator = in->keys[keep].load(relaxed);
+		move_to(in->keys + keep + 1, in->keys + size, right->keys);
+		move_to(in->children + keep + 1, in->children + size + 1, right->children);
+		right->n.store(size - keep - 1, relaxed);
+		sibling = right;
+	}
+	// No one can reach sibling until it is linked in below, and the release
+	// that publishes it (parent's unlock, or the root store) covers its fields
+	n->n.store(keep, relaxed);
+	if (!parent) {
+		inner *new_root = make_inner();
+		new_root->keys[0].store(separator, relaxed);
+		new_root->children[0].store(n, relaxed);
+		new_root->children[1].store(sibling, relaxed);
+		new_root->n.store(1, relaxed);
+		root.store(new_root, std::memory_order_release);
+		return;
+	}
+	int const pn = parent->n.load(relaxed);
+	int const i = child_index(parent, pn, separator);
+	move_up(parent->keys + i, parent->keys + pn, parent->keys + pn + 1);
+	move_up(parent->children + i + 1, parent->children + pn + 1, parent->children + pn + 2);
+	parent->keys[i].store(separator, relaxed);
+	parent->children[i + 1].store(sibling, relaxed);
+	parent->n.store(pn + 1, relaxed);
+}
+
+inline bool olc_tree::insert(int key)
+{
+	for (;;) {
+		node *n;
+		std::uint64_t v;
+		if (!lock_root(n, v))
+			continue;
+		inner *parent = nullptr;
+		std::uint64_t parent_v = 0;
+		bool restart = false;
+		for (;;) {
+			if (full(n)) {
+				// Lock the parent, then n, both as of what we've read; a
+				// root must still be the root once it's locked
+				if (parent ? !upgrade(parent, parent_v) : !validate(n, v)) {
+					restart = true;
+					break;
+				}
+				if (!upgrade(n, v)) {
+					if (parent)
+						unlock(parent);
+					restart = true;
+					break;
+				}
+				if (!parent && root.load(relaxed) != n) {
+					unlock(n);
+					restart = true;
+					break;
+				}
+				split(parent, n);
+				unlock(n);
+				if (parent)
+					unlock(parent);
+				// Simplest to go down again through the new separator
+				restart = true;
+				break;
+			}
+			if (n->is_leaf)
+				break;
+			parent = static_cast<inner *>(n);
+			parent_v = v;
+			if (!descend(n, v, key)) {
+				restart = true;
+				break;
+			}
+		}
+		if (restart)
+			continue;
+
+		leaf *l = static_cast<leaf *>(n);
+		if (!upgrade(l, v))
+			continue;
+		int const size = l->n.load(relaxed);
+		int const i = count_below<false>(l->keys, size, key);
+		bool const added = !(i < size && l->keys[i].load(relaxed) == key);
+		if (added) {
+			move_up(l->keys + i, l->keys + size, l->keys + size + 1);
+			l->keys[i].store(key, relaxed);
+			l->n.store(size + 1, relaxed);
+			count.fetch_add(1, relaxed);
+		}
+		unlock(l);
+		return added;
+	}
+}
+
+inline bool olc_tree::erase(int key)
+{
+	for (;;) {
+		node *n;
+		std::uint64_t v;
+		if (!lock_root(n, v))
+			continue;
+		bool restart = false;
+		while (!n->is_leaf) {
+			if (!descend(n, v, key)) {
+				restart = true;
+				break;
+			}
+		}
+		if (restart)
+			continue;
+
+		leaf *l = static_cast<leaf *>(n);
+		if (!upgrade(l, v))
+			continue;
+		int const size = l->n.load(relaxed);
+		int const i = count_below<false>(l->keys, size, key);
+		bool const found = i < size && l->keys[i].load(relaxed) == key;
+		if (found) {
+			move_to(l->keys + i + 1, l->keys + size, l->keys + i);
+			l->n.store(size - 1, relaxed);
+			count.fetch_sub(1, relaxed);
+		}
+		unlock(l);
+		return found;
+	}
+}
+
+}
+#endif
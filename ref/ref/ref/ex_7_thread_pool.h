@@ -0,0 +1,177 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+// async_accumulate (ex_7_async_accumulate_function.h) starts a new thread
+// for every block on every call. That is fine once, but kernels that are
+// called over and over (e.g. for every panel of a blocked LU factorization)
+// would spend their time creating threads. A thread_pool starts its workers
+// once and feeds them from a single task queue.
+#include <algorithm>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+namespace mpcs51044 {
+
+class thread_pool {
+public:
+    // The thread calling parallel_for() works too, so by default we start
+    // one worker fewer than the hardware has threads
+    explicit thread_pool(unsigned num_threads = default_size())
+    {
+        for (unsigned i = 0; i < num_threads; ++i)
+            threads.emplace_back([this] { worker(); });
+    }
+
+    // Runs whatever is still queued, then joins the workers
+    ~thread_pool()
+    {
+        {
+            std::lock_guard lock(m);
+            done = true;
+        }
+        cv.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    thread_pool(thread_pool const &) = delete;
+    thread_pool &operator=(thread_pool const &) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(threads.size()); }
+
+    template<typename Func>
+    auto submit(Func &&f)
+    {
+        using RetType = std::invoke_result_t<std::decay_t<Func>>;
+        std::packaged_task<RetType()> task(std::forward<Func>(f));
+        auto result = task.get_future();
+        {
+            std::lock_guard lock(m);
+            tasks.emplace_back(std::move(task));
+        }
+        cv.notify_one();
+        return result;
+    }
+
+    // Run one queued task on the calling thread. Returns false if there was none.
+    bool run_pending_task()
+    {
+        std::packaged_task<void()> task;
+        {
+            std::lock_guard lock(m);
+            if (tasks.empty())
+                return false;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    // Wait for f, running queued tasks in the meantime rather than blocking.
+    // This is what lets a task submit more tasks and wait for them without
+    // deadlocking when every worker is busy.
+    template<typename T>
+    void wait(std::future<T> &f)
+    {
+        while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!run_pending_task())
+                f.wait();
+        }
+    }
+
+    // Shared by everyone who doesn't care to make their own
+    static thread_pool &instance()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+    static unsigned default_size()
+    {
+        // hardware_concurrency may return 0 if it doesn't choose to answer
+        unsigned long const hardware_threads = std::thread::hardware_concurrency();
+        return static_cast<unsigned>((hardware_threads != 0 ? hardware_threads : 2) - 1);
+    }
+
+private:
+    void worker()
+    {
+        for (;;) {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock lock(m);
+                cv.wait(lock, [this] { return done || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::packaged_task<void()>> tasks;
+    bool done = false;
+    std::vector<std::thread> threads;
+};
+
+// Call f(block_start, block_end) over [first, last) split into blocks the
+// same way async_accumulate splits its range: at least min_per_thread
+// indices each and no more blocks than there are threads. Unlike there, the
+// leftover length % num_threads indices are spread one each over the first
+// blocks instead of all landing in the last one, which matters when every
+// index is a lot of work. The last block runs on the calling thread.
+// Exceptions are rethrown here once every block has finished (the blocks
+// refer to f, so we can't leave any running).
+template<typename Index, typename Func>
+void parallel_for(Index first, Index last, Index min_per_thread, Func const &f,
+                  thread_pool &pool = thread_pool::instance())
+{
+    if (!(first < last))
+        return;
+    unsigned long const length = static_cast<unsigned long>(last - first);
+    unsigned long const per_thread = min_per_thread > 0 ? static_cast<unsigned long>(min_per_thread) : 1;
+    unsigned long const max_threads = (length + per_thread - 1) / per_thread;
+    unsigned long const num_threads = std::min<unsigned long>(pool.size() + 1, max_threads);
+    unsigned long const block_size = length / num_threads;
+    unsigned long const leftover = length % num_threads;
+    std::vector<std::future<void>> futures(num_threads - 1);
+    Index block_start = first;
+    for (unsigned long i = 0; i < (num_threads - 1); ++i) {
+        Index const block_end = block_start + static_cast<Index>(block_size + (i < leftover ? 1 : 0));
+        futures[i] = pool.submit([&f, block_start, block_end] { f(block_start, block_end); });
+        block_start = block_end;
+    }
+
+    std::exception_ptr error;
+    try {
+        f(block_start, last);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    for (auto &future : futures) {
+        pool.wait(future);
+        try {
+            future.get();
+        }
+        catch (...) {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+}
+#endif